@@ -0,0 +1,164 @@
+/**
+ * @file word_counter_native.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * .Call backend for R/word_counter.R. Streams the file through the C word
+ * counter's tokenizer (c/word_counter/word_engine.c) into a hash table, so
+ * memory grows with the number of distinct words rather than the size of
+ * the input, and returns the top-K as a named integer vector.
+ *
+ * Build: R CMD SHLIB -o R/word_counter_native.so R/word_counter_native.c c/word_counter/word_engine.c
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+
+#include "../c/word_counter/word_engine.h"
+
+/* R's regex tokenizer has no length limit; this only guards pathological runs of letters. */
+#define NATIVE_MAX_WORD_LENGTH 4096
+#define NATIVE_INITIAL_SLOTS 1024
+
+typedef struct NativeEntry {
+    char *word;
+    size_t count;
+} NativeEntry;
+
+/*
+ * Open-addressing table. Everything is allocated with R_alloc, which R
+ * releases when the .Call returns or an error unwinds it, so an R error
+ * raised mid-count cannot leak the table.
+ */
+typedef struct NativeTable {
+    NativeEntry *slots;
+    size_t capacity;
+    size_t used;
+} NativeTable;
+
+static uint64_t hash_word(const char *word) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)word; *p; ++p) {
+        hash = (hash ^ *p) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static NativeEntry *find_slot(NativeEntry *slots, size_t capacity, const char *word) {
+    size_t i = hash_word(word) & (capacity - 1);
+    while (slots[i].word && strcmp(slots[i].word, word) != 0) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+/* Double the table once it is half full. */
+static void grow_table(NativeTable *table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : NATIVE_INITIAL_SLOTS;
+    NativeEntry *slots = (NativeEntry *)R_alloc(capacity, sizeof(*slots));
+    memset(slots, 0, capacity * sizeof(*slots));
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->slots[i].word) {
+            *find_slot(slots, capacity, table->slots[i].word) = table->slots[i];
+        }
+    }
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+static void count_word(NativeTable *table, const char *word) {
+    if ((table->used + 1) * 2 > table->capacity) {
+        grow_table(table);
+    }
+    NativeEntry *slot = find_slot(table->slots, table->capacity, word);
+    if (!slot->word) {
+        size_t length = strlen(word) + 1;
+        slot->word = R_alloc(length, 1);
+        memcpy(slot->word, word, length);
+        table->used++;
+    }
+    slot->count++;
+}
+
+/* Descending count, then alphabetical: the order sort(table(words), decreasing = TRUE) gives. */
+static int compare_entries(const void *a, const void *b) {
+    const NativeEntry *left = *(const NativeEntry *const *)a;
+    const NativeEntry *right = *(const NativeEntry *const *)b;
+    if (left->count != right->count) {
+        return left->count < right->count ? 1 : -1;
+    }
+    return strcmp(left->word, right->word);
+}
+
+/*
+ * wc_native_count(path, top): count the words in path and return the top
+ * most frequent (all of them when top is NA or < 1) as a named integer
+ * vector in descending order. A zero-length vector means no words.
+ */
+SEXP wc_native_count(SEXP path, SEXP top) {
+    if (!isString(path) || LENGTH(path) != 1 || STRING_ELT(path, 0) == NA_STRING) {
+        error("path must be a single file name");
+    }
+    const char *filename = translateChar(STRING_ELT(path, 0));
+    int limit = asInteger(top);
+
+    FILE *file = fopen(R_ExpandFileName(filename), "r");
+    if (!file) {
+        error("Failed to open '%s': %s", filename, strerror(errno));
+    }
+    NativeTable table = {NULL, 0, 0};
+    grow_table(&table);
+    char word[NATIVE_MAX_WORD_LENGTH];
+    int truncated = 0;
+    while (we_next_word(file, word, sizeof(word), 0, &truncated, NULL)) {
+        count_word(&table, word);
+    }
+    int read_failed = ferror(file);
+    fclose(file);
+    if (read_failed) {
+        error("Failed to read '%s'", filename);
+    }
+    if (truncated) {
+        warning("one or more tokens exceeded %d characters and were truncated", NATIVE_MAX_WORD_LENGTH - 1);
+    }
+
+    NativeEntry **entries = (NativeEntry **)R_alloc(table.used ? table.used : 1, sizeof(*entries));
+    size_t distinct = 0;
+    for (size_t i = 0; i < table.capacity; ++i) {
+        if (table.slots[i].word) {
+            entries[distinct++] = &table.slots[i];
+        }
+    }
+    qsort(entries, distinct, sizeof(*entries), compare_entries);
+
+    size_t n = limit != NA_INTEGER && limit > 0 && (size_t)limit < distinct ? (size_t)limit : distinct;
+    SEXP counts = PROTECT(allocVector(INTSXP, (R_xlen_t)n));
+    SEXP names = PROTECT(allocVector(STRSXP, (R_xlen_t)n));
+    for (size_t i = 0; i < n; ++i) {
+        /* Counts past INT_MAX cannot be an R integer; NA is clearer than a wrapped value. */
+        INTEGER(counts)[i] = entries[i]->count > INT_MAX ? NA_INTEGER : (int)entries[i]->count;
+        SET_STRING_ELT(names, (R_xlen_t)i, mkChar(entries[i]->word));
+    }
+    setAttrib(counts, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return counts;
+}
+
+static const R_CallMethodDef call_methods[] = {
+    {"wc_native_count", (DL_FUNC)&wc_native_count, 2},
+    {NULL, NULL, 0}
+};
+
+/* Called by dyn.load; the name must match the shared object's file name. */
+void R_init_word_counter_native(DllInfo *dll) {
+    R_registerRoutines(dll, NULL, call_methods, NULL, NULL);
+    R_useDynamicSymbols(dll, FALSE);
+}
@@ -4,11 +4,17 @@
  * @date 2025-11-11
  *
  * Identifies reachable vs. garbage heap chunks in a toy mark-and-sweep demo.
+ * Marks are kept up to date between queries: new edges mark eagerly, and only
+ * the chunks that hung off overwritten roots are re-checked.
  */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+// initial sizes only; both arrays double whenever they fill up
 #define MAX_STACK_SIZE 10
 #define MAX_HEAP_SIZE 10
 
@@ -17,8 +23,16 @@
 // isn't part of the data the code accesses.
 typedef struct _HeapChunk {
     int num_references;
+    int reference_capacity;
     int marked;
     struct _HeapChunk **references;
+
+    // bookkeeping for incremental queries
+    int index;          // position in the heap array
+    int suspect;        // may have lost its last path from the stack
+    int num_referrers;  // chunks with an edge to this one (with repeats)
+    int referrer_capacity;
+    struct _HeapChunk **referrers;
 } HeapChunk;
 
 // Var on stack. Can have value that is a reference to the Heap, or it could
@@ -34,23 +48,82 @@ typedef struct {
 typedef struct {
     Var *stack;  // array of all current variables
     int num_vars_on_stack;
+    int stack_capacity;
+
+    // hash index from variable name to stack position + 1 (0 = empty slot)
+    int *var_index;
+    int var_index_capacity;
 
     // array of all allocated HeapChunks (so array of pointers)
     HeapChunk **heap;
     int num_heap_chunks;
+    int heap_capacity;
+
+    // incremental reachability: marks are valid once tracking is set
+    int tracking;
+    int queried_heap_chunks;  // chunks that existed at the last query
+    HeapChunk **lost;          // dirty set: old targets of overwritten roots
+    int num_lost;
+    int lost_capacity;
+    HeapChunk **work;          // explicit mark / suspect stack
+    int work_capacity;
+    HeapChunk **suspects;
+    int suspects_capacity;
+    HeapChunk **new_garbage;   // reachable (or new) chunks found dead since the last garbage query
+    int num_new_garbage;
+    int new_garbage_capacity;
 } ProgramState;
 
+/* realloc helper that exits on allocation failure. */
+static void *resizeArray(void *array, size_t bytes) {
+    void *resized = realloc(array, bytes);
+    if (!resized) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return resized;
+}
+
 // make a new program state
 /* Allocate and initialise an empty ProgramState. */
 ProgramState *createProgramState() {
     ProgramState *state = (ProgramState *)malloc(sizeof(ProgramState));
-    state->stack = (Var *)malloc(sizeof(Var) * MAX_STACK_SIZE);
-    state->heap = (HeapChunk **)malloc(sizeof(HeapChunk *) * MAX_HEAP_SIZE);
+    if (!state) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    state->stack = (Var *)resizeArray(NULL, sizeof(Var) * MAX_STACK_SIZE);
+    state->heap = (HeapChunk **)resizeArray(NULL, sizeof(HeapChunk *) * MAX_HEAP_SIZE);
+    state->stack_capacity = MAX_STACK_SIZE;
+    state->heap_capacity = MAX_HEAP_SIZE;
+    state->var_index = NULL;
+    state->var_index_capacity = 0;
     state->num_heap_chunks = 0;
     state->num_vars_on_stack = 0;
+    state->tracking = 0;
+    state->queried_heap_chunks = 0;
+    state->lost = NULL;
+    state->num_lost = 0;
+    state->lost_capacity = 0;
+    state->work = NULL;
+    state->work_capacity = 0;
+    state->suspects = NULL;
+    state->suspects_capacity = 0;
+    state->new_garbage = NULL;
+    state->num_new_garbage = 0;
+    state->new_garbage_capacity = 0;
     return state;
 }
 
+/* Append chunk to a growable pointer array, doubling it when full. */
+static void pushChunk(HeapChunk ***array, int *count, int *capacity, HeapChunk *chunk) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *array = (HeapChunk **)resizeArray(*array, sizeof(HeapChunk *) * (size_t)*capacity);
+    }
+    (*array)[(*count)++] = chunk;
+}
+
 /* strdup helper that exits on allocation failure. */
 static char *duplicateString(const char *input) {
     size_t length = strlen(input) + 1;
@@ -68,42 +141,135 @@ static char *duplicateString(const char *input) {
 /* Allocate a heap chunk and register it with the state. */
 HeapChunk *HeapMalloc(ProgramState *state) {
     HeapChunk *chunk = (HeapChunk *)malloc(sizeof(HeapChunk));
+    if (!chunk) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
     chunk->num_references = 0;
+    chunk->reference_capacity = 0;
+    chunk->marked = 0;
     chunk->references = NULL;
+    chunk->index = state->num_heap_chunks;
+    chunk->suspect = 0;
+    chunk->num_referrers = 0;
+    chunk->referrer_capacity = 0;
+    chunk->referrers = NULL;
+    if (state->num_heap_chunks == state->heap_capacity) {
+        state->heap_capacity *= 2;
+        state->heap = (HeapChunk **)resizeArray(state->heap, sizeof(HeapChunk *) * state->heap_capacity);
+    }
     state->heap[state->num_heap_chunks] = chunk;
     state->num_heap_chunks++;
     return chunk;
 }
 
+/* FNV-1a string hash for the variable index. */
+static unsigned long hashName(const char *name) {
+    unsigned long hash = 2166136261UL;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/* Index slot holding var_name, or the empty slot where it belongs. */
+static int findVarSlot(const ProgramState *state, const char *var_name) {
+    int mask = state->var_index_capacity - 1;
+    int slot = (int)(hashName(var_name) & (unsigned long)mask);
+    while (state->var_index[slot] != 0 &&
+           strcmp(state->stack[state->var_index[slot] - 1].name, var_name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Double the variable index and re-insert every stack variable. */
+static void growVarIndex(ProgramState *state) {
+    int capacity = state->var_index_capacity ? state->var_index_capacity * 2 : 32;
+    free(state->var_index);
+    state->var_index = (int *)calloc((size_t)capacity, sizeof(int));
+    if (!state->var_index) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    state->var_index_capacity = capacity;
+    for (int i = 0; i < state->num_vars_on_stack; i++) {
+        state->var_index[findVarSlot(state, state->stack[i].name)] = i + 1;
+    }
+}
+
+/*
+ * Mark every unmarked chunk reachable from chunk, depth-first via an explicit
+ * stack so long chains cannot overflow the C stack.
+ */
+static void markFrom(ProgramState *state, HeapChunk *chunk) {
+    if (!chunk || chunk->marked) {
+        return;
+    }
+    int depth = 0;
+    chunk->marked = 1;
+    chunk->suspect = 0;
+    pushChunk(&state->work, &depth, &state->work_capacity, chunk);
+    while (depth > 0) {
+        HeapChunk *current = state->work[--depth];
+        for (int i = 0; i < current->num_references; i++) {
+            HeapChunk *target = current->references[i];
+            if (target && !target->marked) {
+                target->marked = 1;
+                target->suspect = 0;
+                pushChunk(&state->work, &depth, &state->work_capacity, target);
+            }
+        }
+    }
+}
+
 // update the stack (either add name/value pair or update value)
 /* Add or update a stack variable to point at a chunk. */
 void setVar(ProgramState *state, const char *var_name, HeapChunk *chunk) {
-    int found = 0;
-    for (int i = 0; i < state->num_vars_on_stack; i++) {
-        if (strcmp(state->stack[i].name, var_name) == 0) {
-            found = 1;
-            state->stack[i].reference = chunk;
+    // keep the index at most half full so probe chains stay short
+    if (2 * (state->num_vars_on_stack + 1) > state->var_index_capacity) {
+        growVarIndex(state);
+    }
+    int slot = findVarSlot(state, var_name);
+    if (state->tracking) {
+        // a new root can only add reachability, so mark right away
+        markFrom(state, chunk);
+    }
+    if (state->var_index[slot] != 0) {
+        Var *var = &state->stack[state->var_index[slot] - 1];
+        if (state->tracking && var->reference && var->reference != chunk) {
+            pushChunk(&state->lost, &state->num_lost, &state->lost_capacity, var->reference);
         }
+        var->reference = chunk;
+        return;
     }
-    if (!found) {
-        state->stack[state->num_vars_on_stack].name = duplicateString(var_name);
-        state->stack[state->num_vars_on_stack].reference = chunk;
-        state->num_vars_on_stack++;
+
+    if (state->num_vars_on_stack == state->stack_capacity) {
+        state->stack_capacity *= 2;
+        state->stack = (Var *)resizeArray(state->stack, sizeof(Var) * state->stack_capacity);
     }
+    state->stack[state->num_vars_on_stack].name = duplicateString(var_name);
+    state->stack[state->num_vars_on_stack].reference = chunk;
+    state->num_vars_on_stack++;
+    state->var_index[slot] = state->num_vars_on_stack;
 }
 
 // adds a reference from chunk_source to chunk_target.
-// method is humorously badly written, don't try to do this for too many
-// references.
+// the reference array doubles when full, so building big graphs is linear.
 /* Append a pointer from chunk_source to chunk_target. */
-void addReference(HeapChunk *chunk_source, HeapChunk *chunk_target) {
-    if (chunk_source->num_references++ == 0)
-        chunk_source->references = malloc(sizeof(HeapChunk *));
-    else
-        chunk_source->references =
-            realloc(chunk_source->references,
-                       chunk_source->num_references * sizeof(HeapChunk *));
-    chunk_source->references[chunk_source->num_references - 1] = chunk_target;
+void addReference(ProgramState *state, HeapChunk *chunk_source, HeapChunk *chunk_target) {
+    pushChunk(&chunk_source->references, &chunk_source->num_references,
+              &chunk_source->reference_capacity, chunk_target);
+    if (!chunk_target) {
+        return;
+    }
+    pushChunk(&chunk_target->referrers, &chunk_target->num_referrers,
+              &chunk_target->referrer_capacity, chunk_source);
+    if (state->tracking && chunk_source->marked) {
+        // a new edge out of a marked chunk can only add reachability
+        markFrom(state, chunk_target);
+    }
 }
 
 // Mark and Sweep, but don't really sweep - just report which chunks are garbage.
@@ -115,37 +281,130 @@ void addReference(HeapChunk *chunk_source, HeapChunk *chunk_target) {
 // caught in any circular references (i.e. think about your stopping conditions).
 // Finally, you should loop through the heap array again, this time reporting for each
 // HeapChunk whether it is reachable or garbage.
-/* Depth-first mark from a given heap chunk. */
-static void markChunk(HeapChunk *chunk) {
-    if (!chunk || chunk->marked) {
-        return;
+/* Clear all marks and trace from every stack root. */
+static void markAll(ProgramState *state) {
+    // Unmark all chunks before performing the depth-first traversal.
+    for (int i = 0; i < state->num_heap_chunks; i++) {
+        if (state->heap[i]) {
+            state->heap[i]->marked = 0;
+            state->heap[i]->suspect = 0;
+        }
     }
 
-    chunk->marked = 1;
-
-    for (int i = 0; i < chunk->num_references; i++) {
-        markChunk(chunk->references[i]);
+    // Mark any chunks that can be reached from the stack roots.
+    for (int i = 0; i < state->num_vars_on_stack; i++) {
+        markFrom(state, state->stack[i].reference);
     }
 }
 
-/* Clear all marks, traverse from stack roots, then report reachability. */
-void markAndSweep(ProgramState *state) {
-    if (!state) {
-        return;
+/*
+ * Bring the marks up to date with every edit since the last query. Only
+ * chunks reachable from the old targets of overwritten roots are suspects;
+ * they are unmarked and re-marked if a root or a still-marked referrer keeps
+ * them alive. Suspects that stay unmarked, and new chunks that were never
+ * reached, are added to the new-garbage list.
+ */
+static void updateReachability(ProgramState *state) {
+    if (!state->tracking) {
+        markAll(state);
+        state->tracking = 1;
+    } else if (state->num_lost > 0) {
+        int num_suspects = 0;
+        for (int i = 0; i < state->num_lost; i++) {
+            HeapChunk *chunk = state->lost[i];
+            if (chunk->marked && !chunk->suspect) {
+                chunk->suspect = 1;
+                pushChunk(&state->suspects, &num_suspects, &state->suspects_capacity, chunk);
+            }
+        }
+        for (int s = 0; s < num_suspects; s++) {
+            HeapChunk *chunk = state->suspects[s];
+            for (int i = 0; i < chunk->num_references; i++) {
+                HeapChunk *target = chunk->references[i];
+                if (target && target->marked && !target->suspect) {
+                    target->suspect = 1;
+                    pushChunk(&state->suspects, &num_suspects, &state->suspects_capacity, target);
+                }
+            }
+        }
+        for (int s = 0; s < num_suspects; s++) {
+            state->suspects[s]->marked = 0;
+        }
+
+        // Re-mark suspects still held by a root or by a chunk outside the suspect set.
+        for (int i = 0; i < state->num_vars_on_stack; i++) {
+            HeapChunk *root = state->stack[i].reference;
+            if (root && root->suspect) {
+                markFrom(state, root);
+            }
+        }
+        for (int s = 0; s < num_suspects; s++) {
+            HeapChunk *chunk = state->suspects[s];
+            for (int i = 0; chunk->suspect && i < chunk->num_referrers; i++) {
+                if (chunk->referrers[i]->marked) {
+                    markFrom(state, chunk);
+                }
+            }
+        }
+
+        for (int s = 0; s < num_suspects; s++) {
+            HeapChunk *chunk = state->suspects[s];
+            if (chunk->suspect) {
+                chunk->suspect = 0;
+                // chunks allocated since the last query are reported below
+                if (chunk->index < state->queried_heap_chunks) {
+                    pushChunk(&state->new_garbage, &state->num_new_garbage,
+                              &state->new_garbage_capacity, chunk);
+                }
+            }
+        }
     }
+    state->num_lost = 0;
 
-    // Unmark all chunks before performing the depth-first traversal.
-    for (int i = 0; i < state->num_heap_chunks; i++) {
-        if (state->heap[i]) {
-            state->heap[i]->marked = 0;
+    for (int i = state->queried_heap_chunks; i < state->num_heap_chunks; i++) {
+        if (!state->heap[i]->marked) {
+            pushChunk(&state->new_garbage, &state->num_new_garbage, &state->new_garbage_capacity,
+                      state->heap[i]);
         }
     }
+    state->queried_heap_chunks = state->num_heap_chunks;
+}
 
-    // Mark any chunks that can be reached from the stack roots.
-    for (int i = 0; i < state->num_vars_on_stack; i++) {
-        markChunk(state->stack[i].reference);
+/* Return 1 if chunk is reachable from the stack after all edits so far. */
+int isReachable(ProgramState *state, HeapChunk *chunk) {
+    updateReachability(state);
+    return chunk && chunk->marked;
+}
+
+/* Answer isReachable for count chunks at once, writing 0/1 into results. */
+void areReachable(ProgramState *state, HeapChunk **chunks, int count, int *results) {
+    updateReachability(state);
+    for (int i = 0; i < count; i++) {
+        results[i] = chunks[i] && chunks[i]->marked;
+    }
+}
+
+/*
+ * Chunks that became garbage since the previous call (including chunks
+ * allocated since then and never reached). The array stays valid until the
+ * next query; its length is returned.
+ */
+int newGarbage(ProgramState *state, HeapChunk ***chunks) {
+    updateReachability(state);
+    *chunks = state->new_garbage;
+    int count = state->num_new_garbage;
+    state->num_new_garbage = 0;
+    return count;
+}
+
+/* Bring marks up to date, then report reachability for every chunk. */
+void markAndSweep(ProgramState *state) {
+    if (!state) {
+        return;
     }
 
+    updateReachability(state);
+
     // Report which chunks are still reachable and which are garbage.
     for (int i = 0; i < state->num_heap_chunks; i++) {
         HeapChunk *chunk = state->heap[i];
@@ -155,8 +414,79 @@ void markAndSweep(ProgramState *state) {
 }
 
 
+/* Seconds elapsed since start on the monotonic clock. */
+static double secondsSince(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Allocate a list of length chunks and return its head. */
+static HeapChunk *buildList(ProgramState *state, int length) {
+    HeapChunk *head = HeapMalloc(state);
+    HeapChunk *tail = head;
+    for (int i = 1; i < length; i++) {
+        HeapChunk *next = HeapMalloc(state);
+        addReference(state, tail, next);
+        tail = next;
+    }
+    return head;
+}
+
+/*
+ * Root num_chunks chunks as lists of list_length, then repeatedly replace one
+ * root's list and ask which chunks died. Compares the incremental update with
+ * clearing and re-tracing the whole heap for each query.
+ */
+static void runScaleTest(int num_chunks, int list_length, int edits) {
+    ProgramState *state = createProgramState();
+    int num_roots = num_chunks / list_length > 0 ? num_chunks / list_length : 1;
+    char name[32];
+    for (int r = 0; r < num_roots; r++) {
+        snprintf(name, sizeof(name), "root%d", r);
+        setVar(state, name, buildList(state, list_length));
+    }
+    HeapChunk **garbage;
+    newGarbage(state, &garbage);
+
+    unsigned long long seed = 12345;
+    int found = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int e = 0; e < edits; e++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        snprintf(name, sizeof(name), "root%llu", (seed >> 33) % (unsigned long long)num_roots);
+        setVar(state, name, buildList(state, list_length));
+        found += newGarbage(state, &garbage);
+    }
+    double incremental = secondsSince(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int e = 0; e < edits; e++) {
+        markAll(state);
+    }
+    double full = secondsSince(&start);
+
+    printf("%d chunks in %d rooted lists of %d, %d root replacements\n", state->num_heap_chunks, num_roots,
+           list_length, edits);
+    printf("incremental: %d chunks reported dead, %.2f us per edit+query (includes building the list)\n",
+           found, incremental / edits * 1e6);
+    printf("full re-mark: %.2f us per query\n", full / edits * 1e6);
+}
+
 /* Build the custom scenario and print which chunks are garbage. */
-int main() {
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--scale") == 0) {
+        int num_chunks = argc >= 3 ? atoi(argv[2]) : 1000000;
+        int edits = argc >= 4 ? atoi(argv[3]) : 1000;
+        runScaleTest(num_chunks > 0 ? num_chunks : 1000000, 100, edits > 0 ? edits : 1000);
+        return 0;
+    }
+    if (argc >= 2) {
+        fprintf(stderr, "Usage: %s [--scale [chunks] [edits]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
     ProgramState *state = createProgramState();
 
     /*
@@ -170,19 +500,46 @@ int main() {
 
     HeapChunk *beta = HeapMalloc(state);
     setVar(state, "b", beta);
-    addReference(alpha, beta);
+    addReference(state, alpha, beta);
 
     HeapChunk *gamma = HeapMalloc(state);
     setVar(state, "c", gamma);
-    addReference(beta, gamma);
+    addReference(state, beta, gamma);
 
     HeapChunk *delta = HeapMalloc(state);
-    addReference(gamma, delta);
+    addReference(state, gamma, delta);
 
     HeapChunk *cycle_left = HeapMalloc(state);
     HeapChunk *cycle_right = HeapMalloc(state);
-    addReference(cycle_left, cycle_right);
-    addReference(cycle_right, cycle_left);
+    addReference(state, cycle_left, cycle_right);
+    addReference(state, cycle_right, cycle_left);
 
     markAndSweep(state);
+
+    /*
+     * Incremental edits: clearing a and b strands alpha and beta (nothing
+     * points back at them), and moving c to delta strands gamma along with
+     * epsilon, which was only ever reachable through gamma.
+     */
+    HeapChunk **garbage;
+    newGarbage(state, &garbage);
+    setVar(state, "a", NULL);
+    setVar(state, "b", NULL);
+    HeapChunk *epsilon = HeapMalloc(state);
+    addReference(state, gamma, epsilon);
+    setVar(state, "c", delta);
+
+    HeapChunk *queries[] = {alpha, beta, gamma, delta, epsilon};
+    int reachable[5];
+    areReachable(state, queries, 5, reachable);
+    printf("\nAfter clearing a and b and moving c to delta:\n");
+    for (int i = 0; i < 5; i++) {
+        printf("HeapChunk[%d] is %s.\n", queries[i]->index, reachable[i] ? "reachable" : "garbage");
+    }
+    int count = newGarbage(state, &garbage);
+    printf("Became garbage since the last query:");
+    for (int i = 0; i < count; i++) {
+        printf(" HeapChunk[%d]", garbage[i]->index);
+    }
+    printf("\n");
 }
@@ -1,16 +1,47 @@
+#define _POSIX_C_SOURCE 200809L
+
 /**
  * @file mark_sweep.c
  * @author Max Petite
  * @date 2025-11-11
  *
  * Simulates a mark-and-sweep garbage collector with explicit stack/heap state.
+ * An optional two-generation mode keeps new chunks in a nursery that is
+ * collected on its own, using a remembered set of old-to-young references.
+ * Two moving modes bump-allocate chunks in a contiguous space and relocate
+ * survivors: a Cheney semi-space copier and a sliding (LISP2) mark-compact.
+ * All arrays grow geometrically and stack variables are found through a
+ * hashed name index, so large simulated programs set up in linear time.
+ * A synthetic workload generator and --bench driver report GC cost as CSV/JSON,
+ * and --burst replays R/gc_timing.R's allocation bursts in the same CSV schema.
+ * Heap graphs can be saved to and replayed from binary or text snapshots.
+ * Every collection is logged with its timings, tracing work and occupancy,
+ * and large heaps print as a compact summary instead of a full dump.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef SAMPLING_PROFILER
+#include "../shared/sampling_profiler.h"
+#endif
 
 #define MAX_NAME_LENGTH 32
+#define DEFAULT_PROMOTION_AGE 2
+#define LOCALITY_PAGE_SIZE 4096
+/* Heaps with more chunks than this print as a summary, not a full dump. */
+#define PRINT_STATE_LIMIT 64
+/* Pause histogram bucket b counts pauses in [2^b, 2^(b+1)) microseconds. */
+#define PAUSE_HISTOGRAM_BUCKETS 24
 
 typedef struct HeapChunk HeapChunk;
 
@@ -19,25 +50,145 @@ typedef struct Var {
     HeapChunk *ref;
 } Var;
 
+typedef enum Generation {
+    GENERATION_YOUNG = 0,
+    GENERATION_OLD = 1
+} Generation;
+
 struct HeapChunk {
     char label[MAX_NAME_LENGTH];
     int marked;
+    Generation generation;
+    unsigned age;       /* minor collections survived while in the nursery */
+    int remembered;     /* already recorded in the remembered set */
+    HeapChunk *forward; /* new address while a moving collection runs */
+    int slab_backed;    /* bulk-loaded: memory is released with the state, not per chunk */
     size_t reference_capacity;
     HeapChunk **references;
 };
 
+typedef enum CollectorMode {
+    COLLECTOR_MARK_SWEEP,
+    COLLECTOR_GENERATIONAL,
+    COLLECTOR_COPYING,
+    COLLECTOR_MARK_COMPACT
+} CollectorMode;
+
+/* One collection as seen by the telemetry log. */
+typedef struct GcEvent {
+    int major;
+    double start_seconds;   /* since the ProgramState was created */
+    double pause_seconds;
+    double mark_seconds;
+    double sweep_seconds;
+    size_t chunks_visited;
+    size_t edges_traced;
+    size_t chunks_freed;
+    size_t bytes_freed;
+    size_t chunks_before;
+    size_t chunks_after;
+    size_t bytes_before;
+    size_t bytes_after;
+} GcEvent;
+
+/* Running totals used to compare collectors. */
+typedef struct GcStats {
+    size_t minor_collections;
+    size_t major_collections;
+    double total_seconds;
+    double max_pause_seconds;
+    double mark_seconds;    /* tracing (and copying, for the semi-space collector) */
+    double sweep_seconds;   /* freeing, promotion or compaction after the trace */
+    size_t chunks_visited;  /* chunks marked or copied */
+    size_t edges_traced;    /* non-NULL slots followed while tracing */
+    size_t chunks_freed;
+    size_t bytes_freed;
+    size_t pause_histogram[PAUSE_HISTOGRAM_BUCKETS];
+    /* Every collection in order, for percentiles and the event log. */
+    GcEvent *events;
+    size_t event_count;
+    size_t event_capacity;
+} GcStats;
+
 typedef struct ProgramState {
     Var *stack;
     size_t stack_size;
     size_t stack_capacity;
+    /* Open-addressed name index: stack position + 1, or 0 for an empty slot. */
+    size_t *var_slots;
+    size_t var_slot_capacity;
+    /* Old generation (or the whole heap when not generational). */
     HeapChunk **heap;
     size_t heap_size;
     size_t heap_capacity;
+    /* Bytes held by every allocated chunk, in either generation. */
+    size_t heap_bytes;
+
+    CollectorMode collector;
+    HeapChunk **nursery;
+    size_t nursery_size;
+    size_t nursery_capacity;
+    /* Old chunks that may hold references into the nursery. */
+    HeapChunk **remembered;
+    size_t remembered_size;
+    unsigned promotion_age;
+
+    /*
+     * Moving modes: chunks (header plus inline reference slots) are
+     * bump-allocated from space. The copier evacuates into to_space and swaps.
+     */
+    unsigned char *space;
+    unsigned char *to_space;
+    size_t space_used;
+    size_t space_bytes;
+
+    /* Explicit mark stack so deep graphs cannot overflow the C stack. */
+    HeapChunk **mark_stack;
+    size_t mark_stack_capacity;
+
+    /* Bulk allocations made by the snapshot loader. */
+    void **slabs;
+    size_t slab_count;
+    size_t slab_capacity;
+
+    struct timespec created;
+    GcStats stats;
 } ProgramState;
 
-/* Initialise a ProgramState with bounded stack/heap arrays. */
+static void run_gc(ProgramState *state);
+static void run_minor_gc(ProgramState *state);
+
+/*
+ * Grow an array geometrically until it holds at least min_count elements.
+ * Returns the (possibly moved) array and updates *capacity.
+ */
+static void *grow_array(void *array, size_t *capacity, size_t min_count, size_t element_size,
+                        const char *what) {
+    size_t new_capacity = *capacity > 0 ? *capacity : 16;
+    while (new_capacity < min_count) {
+        new_capacity *= 2;
+    }
+    if (new_capacity == *capacity) {
+        return array;
+    }
+    void *grown = realloc(array, new_capacity * element_size);
+    if (!grown) {
+        fprintf(stderr, "Failed to grow %s to %zu entries.\n", what, new_capacity);
+        exit(EXIT_FAILURE);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+/*
+ * Initialise a ProgramState. The capacities are starting sizes only: the stack
+ * and heap arrays grow geometrically as the simulated program needs them.
+ */
 static ProgramState create_program_state(size_t stack_capacity, size_t heap_capacity) {
     ProgramState state;
+    memset(&state, 0, sizeof(state));
+    stack_capacity = stack_capacity > 0 ? stack_capacity : 1;
+    heap_capacity = heap_capacity > 0 ? heap_capacity : 1;
     state.stack = calloc(stack_capacity, sizeof(*state.stack));
     state.heap = calloc(heap_capacity, sizeof(*state.heap));
     if (!state.stack || !state.heap) {
@@ -48,29 +199,221 @@ static ProgramState create_program_state(size_t stack_capacity, size_t heap_capa
     state.stack_capacity = stack_capacity;
     state.heap_size = 0;
     state.heap_capacity = heap_capacity;
+    state.collector = COLLECTOR_MARK_SWEEP;
+    clock_gettime(CLOCK_MONOTONIC, &state.created);
     return state;
 }
 
+/*
+ * Switch an empty ProgramState to two-generation mode. New chunks land in a
+ * nursery of nursery_capacity slots and are promoted to the old generation
+ * after surviving promotion_age minor collections.
+ */
+static void enable_generational(ProgramState *state, size_t nursery_capacity, unsigned promotion_age) {
+    state->nursery = calloc(nursery_capacity, sizeof(*state->nursery));
+    /* Every old chunk can appear at most once in the remembered set. */
+    state->remembered = calloc(state->heap_capacity, sizeof(*state->remembered));
+    if (!state->nursery || !state->remembered) {
+        fprintf(stderr, "Failed to allocate generational state.\n");
+        exit(EXIT_FAILURE);
+    }
+    state->nursery_size = 0;
+    state->nursery_capacity = nursery_capacity;
+    state->remembered_size = 0;
+    state->promotion_age = promotion_age > 0 ? promotion_age : 1;
+    state->collector = COLLECTOR_GENERATIONAL;
+}
+
+/* Return 1 if the collector relocates chunks inside a contiguous space. */
+static int is_moving_collector(const ProgramState *state) {
+    return state->collector == COLLECTOR_COPYING || state->collector == COLLECTOR_MARK_COMPACT;
+}
+
+/*
+ * Switch an empty ProgramState to a moving collector whose allocation space
+ * holds space_bytes of chunks. The copier reserves a second space of equal size.
+ */
+static void enable_moving(ProgramState *state, CollectorMode collector, size_t space_bytes) {
+    state->space = malloc(space_bytes);
+    state->to_space = collector == COLLECTOR_COPYING ? malloc(space_bytes) : NULL;
+    if (!state->space || (collector == COLLECTOR_COPYING && !state->to_space)) {
+        fprintf(stderr, "Failed to allocate %zu-byte collector space.\n", space_bytes);
+        exit(EXIT_FAILURE);
+    }
+    state->space_used = 0;
+    state->space_bytes = space_bytes;
+    state->collector = collector;
+}
+
+/*
+ * Bytes a chunk occupies: header followed by its slots. Moving spaces store
+ * exactly this; non-moving chunks use the same figure for accounting.
+ */
+static size_t chunk_footprint(size_t reference_capacity) {
+    return sizeof(HeapChunk) + reference_capacity * sizeof(HeapChunk *);
+}
+
+/* Release one chunk and its reference array, counting it as reclaimed. */
+static void free_chunk(ProgramState *state, HeapChunk *chunk) {
+    size_t bytes = chunk_footprint(chunk->reference_capacity);
+    state->heap_bytes -= bytes;
+    ++state->stats.chunks_freed;
+    state->stats.bytes_freed += bytes;
+    if (chunk->slab_backed) {
+        return;
+    }
+    free(chunk->references);
+    free(chunk);
+}
+
 /* Free all heap chunks plus the owning ProgramState buffers. */
 static void destroy_program_state(ProgramState *state) {
     if (!state) {
         return;
     }
-    for (size_t i = 0; i < state->heap_size; ++i) {
-        free(state->heap[i]->references);
-        free(state->heap[i]);
+    /* Chunks in a moving space die with the space itself. */
+    if (!is_moving_collector(state)) {
+        for (size_t i = 0; i < state->heap_size; ++i) {
+            free_chunk(state, state->heap[i]);
+        }
+    }
+    for (size_t i = 0; i < state->nursery_size; ++i) {
+        free_chunk(state, state->nursery[i]);
     }
+    for (size_t i = 0; i < state->slab_count; ++i) {
+        free(state->slabs[i]);
+    }
+    free(state->slabs);
+    free(state->stats.events);
+    free(state->space);
+    free(state->to_space);
     free(state->heap);
+    free(state->nursery);
+    free(state->remembered);
+    free(state->mark_stack);
+    free(state->var_slots);
     free(state->stack);
 }
 
+/* Double the old generation (or whole heap) and its companion arrays. */
+static void grow_heap(ProgramState *state) {
+    size_t capacity = state->heap_capacity;
+    state->heap = grow_array(state->heap, &state->heap_capacity, capacity * 2,
+                             sizeof(*state->heap), "heap");
+    if (state->collector == COLLECTOR_GENERATIONAL) {
+        /* The remembered set was sized to the old generation; keep it that way. */
+        state->remembered = grow_array(state->remembered, &capacity, state->heap_capacity,
+                                       sizeof(*state->remembered), "remembered set");
+    }
+}
+
+static void copying_collect(ProgramState *state);
+static double seconds_since(const struct timespec *start);
+static void begin_collection(ProgramState *state, GcEvent *event, int major, struct timespec *start);
+static void finish_collection(ProgramState *state, GcEvent *event, const struct timespec *start,
+                              double mark_seconds);
+
+/*
+ * Replace the moving space with a larger one by evacuating live chunks into
+ * it, so the new space has room for at least bytes more after the copy. The
+ * copy is a real major collection, so it is logged and counted as one.
+ */
+static void grow_moving_space(ProgramState *state, size_t bytes) {
+    size_t new_bytes = state->space_bytes * 2;
+    while (new_bytes < 2 * (state->space_used + bytes)) {
+        new_bytes *= 2;
+    }
+    unsigned char *old_to_space = state->to_space;
+    state->to_space = malloc(new_bytes);
+    if (!state->to_space) {
+        fprintf(stderr, "Failed to grow collector space to %zu bytes.\n", new_bytes);
+        exit(EXIT_FAILURE);
+    }
+    GcEvent event;
+    struct timespec start;
+    begin_collection(state, &event, 1, &start);
+    copying_collect(state);
+    finish_collection(state, &event, &start, seconds_since(&start));
+    /* copying_collect swapped the spaces; to_space now holds the old space. */
+    free(state->to_space);
+    free(old_to_space);
+    state->to_space = NULL;
+    if (state->collector == COLLECTOR_COPYING) {
+        state->to_space = malloc(new_bytes);
+        if (!state->to_space) {
+            fprintf(stderr, "Failed to grow collector space to %zu bytes.\n", new_bytes);
+            exit(EXIT_FAILURE);
+        }
+    }
+    state->space_bytes = new_bytes;
+}
+
+/*
+ * Collect when the allocation space is full, then grow it geometrically if the
+ * survivors still occupy more than half of it. Callers must root any chunk
+ * they still need before allocating again, exactly as a real mutator would.
+ */
+static void make_room(ProgramState *state, size_t bytes) {
+    if (is_moving_collector(state)) {
+        if (state->heap_size < state->heap_capacity && state->space_used + bytes <= state->space_bytes) {
+            return;
+        }
+        run_gc(state);
+        if (state->heap_size >= state->heap_capacity / 2) {
+            grow_heap(state);
+        }
+        if (state->space_used + bytes > state->space_bytes / 2) {
+            grow_moving_space(state, bytes);
+        }
+    } else if (state->collector == COLLECTOR_GENERATIONAL) {
+        if (state->nursery_size < state->nursery_capacity) {
+            return;
+        }
+        run_minor_gc(state);
+        if (state->heap_size >= state->heap_capacity) {
+            /* The old generation is full and blocks promotion; collect everything. */
+            run_gc(state);
+            if (state->heap_size >= state->heap_capacity / 2) {
+                grow_heap(state);
+            }
+        }
+        if (state->nursery_size >= state->nursery_capacity) {
+            /* Every nursery chunk is live and too young to promote. */
+            state->nursery = grow_array(state->nursery, &state->nursery_capacity, state->nursery_capacity * 2,
+                                        sizeof(*state->nursery), "nursery");
+        }
+    } else {
+        if (state->heap_size < state->heap_capacity) {
+            return;
+        }
+        run_gc(state);
+        if (state->heap_size >= state->heap_capacity / 2) {
+            grow_heap(state);
+        }
+    }
+}
+
 /* Create a labeled heap chunk reserved for a certain fan-out. */
 static HeapChunk *allocate_chunk(ProgramState *state, const char *label, size_t reference_capacity) {
-    if (state->heap_size >= state->heap_capacity) {
-        fprintf(stderr, "Heap capacity exceeded when allocating %s.\n", label);
-        exit(EXIT_FAILURE);
+    if (is_moving_collector(state)) {
+        size_t bytes = chunk_footprint(reference_capacity);
+        make_room(state, bytes);
+
+        /* Bump-pointer allocation: the slots follow the header inline. */
+        HeapChunk *chunk = (HeapChunk *)(state->space + state->space_used);
+        state->space_used += bytes;
+        memset(chunk, 0, bytes);
+        strncpy(chunk->label, label, sizeof(chunk->label) - 1);
+        chunk->generation = GENERATION_OLD;
+        chunk->reference_capacity = reference_capacity;
+        chunk->references = (HeapChunk **)(chunk + 1);
+        state->heap[state->heap_size++] = chunk;
+        state->heap_bytes += bytes;
+        return chunk;
     }
 
+    make_room(state, 0);
+
     HeapChunk *chunk = calloc(1, sizeof(*chunk));
     if (!chunk) {
         fprintf(stderr, "Failed to allocate heap chunk %s.\n", label);
@@ -87,18 +430,60 @@ static HeapChunk *allocate_chunk(ProgramState *state, const char *label, size_t
         exit(EXIT_FAILURE);
     }
 
-    state->heap[state->heap_size++] = chunk;
+    state->heap_bytes += chunk_footprint(reference_capacity);
+    if (state->collector == COLLECTOR_GENERATIONAL) {
+        chunk->generation = GENERATION_YOUNG;
+        state->nursery[state->nursery_size++] = chunk;
+    } else {
+        chunk->generation = GENERATION_OLD;
+        state->heap[state->heap_size++] = chunk;
+    }
     return chunk;
 }
 
+/* FNV-1a over the stored (possibly truncated) variable name. */
+static size_t hash_name(const char *name) {
+    size_t hash = (size_t)14695981039346656037ULL;
+    for (size_t i = 0; i < MAX_NAME_LENGTH - 1 && name[i] != '\0'; ++i) {
+        hash ^= (unsigned char)name[i];
+        hash *= (size_t)1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Index slot holding name, or the empty slot where it would be inserted. */
+static size_t find_var_slot(const ProgramState *state, const char *name) {
+    size_t mask = state->var_slot_capacity - 1;
+    size_t slot = hash_name(name) & mask;
+    while (state->var_slots[slot] != 0 &&
+           strncmp(state->stack[state->var_slots[slot] - 1].name, name, MAX_NAME_LENGTH - 1) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Rebuild the name index at twice the size once it passes half full. */
+static void grow_var_index(ProgramState *state) {
+    size_t capacity = state->var_slot_capacity ? state->var_slot_capacity * 2 : 64;
+    free(state->var_slots);
+    state->var_slots = calloc(capacity, sizeof(*state->var_slots));
+    if (!state->var_slots) {
+        fprintf(stderr, "Failed to allocate variable index.\n");
+        exit(EXIT_FAILURE);
+    }
+    state->var_slot_capacity = capacity;
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        state->var_slots[find_var_slot(state, state->stack[i].name)] = i + 1;
+    }
+}
+
 /* Find a stack slot by name or return NULL. */
 static Var *find_variable(ProgramState *state, const char *name) {
-    for (size_t i = 0; i < state->stack_size; ++i) {
-        if (strcmp(state->stack[i].name, name) == 0) {
-            return &state->stack[i];
-        }
+    if (state->var_slot_capacity == 0) {
+        return NULL;
     }
-    return NULL;
+    size_t index = state->var_slots[find_var_slot(state, name)];
+    return index ? &state->stack[index - 1] : NULL;
 }
 
 /* Set (or create) a stack variable to reference a chunk. */
@@ -106,40 +491,99 @@ static void update_stack(ProgramState *state, const char *name, HeapChunk *chunk
     Var *var = find_variable(state, name);
     if (!var) {
         if (state->stack_size >= state->stack_capacity) {
-            fprintf(stderr, "Stack capacity exceeded when updating %s.\n", name);
-            exit(EXIT_FAILURE);
+            state->stack = grow_array(state->stack, &state->stack_capacity, state->stack_size + 1,
+                                      sizeof(*state->stack), "stack");
         }
-        var = &state->stack[state->stack_size++];
+        if (2 * (state->stack_size + 1) > state->var_slot_capacity) {
+            grow_var_index(state);
+        }
+        var = &state->stack[state->stack_size];
+        memset(var->name, 0, sizeof(var->name));
         strncpy(var->name, name, sizeof(var->name) - 1);
-        var->name[sizeof(var->name) - 1] = '\0';
+        state->var_slots[find_var_slot(state, var->name)] = ++state->stack_size;
     }
     var->ref = chunk;
 }
 
-/* Wire one chunk's reference slot to another chunk. */
-static void connect_chunks(HeapChunk *from, size_t index, HeapChunk *to) {
+/* Record an old chunk that now points into the nursery. */
+static void remember_chunk(ProgramState *state, HeapChunk *chunk) {
+    if (chunk->remembered) {
+        return;
+    }
+    chunk->remembered = 1;
+    state->remembered[state->remembered_size++] = chunk;
+}
+
+/*
+ * Wire one chunk's reference slot to another chunk. In generational mode this
+ * is also the write barrier: old-to-young stores are added to the remembered set.
+ */
+static void connect_chunks(ProgramState *state, HeapChunk *from, size_t index, HeapChunk *to) {
     if (index >= from->reference_capacity) {
         fprintf(stderr, "Reference index %zu out of bounds for %s.\n", index, from->label);
         exit(EXIT_FAILURE);
     }
     from->references[index] = to;
+    if (state->collector == COLLECTOR_GENERATIONAL && to &&
+        from->generation == GENERATION_OLD && to->generation == GENERATION_YOUNG) {
+        remember_chunk(state, from);
+    }
 }
 
-/* Recursively mark all chunks reachable from the argument. */
-static void mark_chunk(HeapChunk *chunk) {
-    if (!chunk || chunk->marked) {
+/*
+ * Mark all chunks reachable from the argument, depth-first via the explicit
+ * mark stack. With young_only set, tracing stops at old chunks so only the
+ * nursery is visited.
+ */
+static void mark_from(ProgramState *state, HeapChunk *root, int young_only) {
+    if (!root || root->marked || (young_only && root->generation != GENERATION_YOUNG)) {
         return;
     }
-    chunk->marked = 1;
-    for (size_t i = 0; i < chunk->reference_capacity; ++i) {
-        mark_chunk(chunk->references[i]);
+    root->marked = 1;
+    ++state->stats.chunks_visited;
+    size_t depth = 0;
+    if (state->mark_stack_capacity == 0) {
+        state->mark_stack = grow_array(state->mark_stack, &state->mark_stack_capacity, 1,
+                                       sizeof(*state->mark_stack), "mark stack");
+    }
+    state->mark_stack[depth++] = root;
+
+    while (depth > 0) {
+        HeapChunk *chunk = state->mark_stack[--depth];
+        for (size_t i = 0; i < chunk->reference_capacity; ++i) {
+            HeapChunk *target = chunk->references[i];
+            if (!target) {
+                continue;
+            }
+            ++state->stats.edges_traced;
+            if (target->marked || (young_only && target->generation != GENERATION_YOUNG)) {
+                continue;
+            }
+            target->marked = 1;
+            ++state->stats.chunks_visited;
+            if (depth >= state->mark_stack_capacity) {
+                state->mark_stack = grow_array(state->mark_stack, &state->mark_stack_capacity, depth + 1,
+                                               sizeof(*state->mark_stack), "mark stack");
+            }
+            state->mark_stack[depth++] = target;
+        }
     }
 }
 
+/* Mark all chunks reachable from the argument. */
+static void mark_chunk(ProgramState *state, HeapChunk *chunk) {
+    mark_from(state, chunk, 0);
+}
+
+/* Like mark_chunk, but stops at old chunks so only the nursery is traced. */
+static void mark_young_chunk(ProgramState *state, HeapChunk *chunk) {
+    mark_from(state, chunk, 1);
+}
+
 /* Start marking from every stack root. */
 static void mark_phase(ProgramState *state) {
     for (size_t i = 0; i < state->stack_size; ++i) {
-        mark_chunk(state->stack[i].ref);
+        mark_chunk(state, state->stack[i].ref);
     }
 }
 
@@ -149,8 +593,7 @@ static void sweep_phase(ProgramState *state) {
     for (size_t read_index = 0; read_index < state->heap_size; ++read_index) {
         HeapChunk *chunk = state->heap[read_index];
         if (!chunk->marked) {
-            free(chunk->references);
-            free(chunk);
+            free_chunk(state, chunk);
             continue;
         }
         chunk->marked = 0;
@@ -159,30 +602,475 @@ static void sweep_phase(ProgramState *state) {
     state->heap_size = write_index;
 }
 
-/* Convenience wrapper that performs mark then sweep. */
-static void run_gc(ProgramState *state) {
-    puts("\nRunning mark-and-sweep garbage collector...");
+/* Return 1 if any reference slot of the chunk points into the nursery. */
+static int has_young_reference(const HeapChunk *chunk) {
+    for (size_t i = 0; i < chunk->reference_capacity; ++i) {
+        if (chunk->references[i] && chunk->references[i]->generation == GENERATION_YOUNG) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Free unmarked nursery chunks. Survivors age by one collection and move to
+ * the old generation once they reach the promotion age and there is room.
+ */
+static void sweep_nursery(ProgramState *state, HeapChunk **promoted, size_t *promoted_count) {
+    size_t write_index = 0;
+    for (size_t read_index = 0; read_index < state->nursery_size; ++read_index) {
+        HeapChunk *chunk = state->nursery[read_index];
+        if (!chunk->marked) {
+            free_chunk(state, chunk);
+            continue;
+        }
+        chunk->marked = 0;
+        ++chunk->age;
+        if (chunk->age >= state->promotion_age && state->heap_size < state->heap_capacity) {
+            chunk->generation = GENERATION_OLD;
+            state->heap[state->heap_size++] = chunk;
+            promoted[(*promoted_count)++] = chunk;
+            continue;
+        }
+        state->nursery[write_index++] = chunk;
+    }
+    state->nursery_size = write_index;
+}
+
+/* Drop remembered entries that no longer point into the nursery. */
+static void prune_remembered_set(ProgramState *state) {
+    size_t write_index = 0;
+    for (size_t i = 0; i < state->remembered_size; ++i) {
+        HeapChunk *chunk = state->remembered[i];
+        if (has_young_reference(chunk)) {
+            state->remembered[write_index++] = chunk;
+        } else {
+            chunk->remembered = 0;
+        }
+    }
+    state->remembered_size = write_index;
+}
+
+/* Seconds elapsed since start on the monotonic clock. */
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Start timing a collection: note when it began and the heap occupancy and
+ * counters it starts from.
+ */
+static void begin_collection(ProgramState *state, GcEvent *event, int major, struct timespec *start) {
+    clock_gettime(CLOCK_MONOTONIC, start);
+    memset(event, 0, sizeof(*event));
+    event->major = major;
+    event->start_seconds = (start->tv_sec - state->created.tv_sec) +
+                           (start->tv_nsec - state->created.tv_nsec) / 1e9;
+    event->chunks_before = state->heap_size + state->nursery_size;
+    event->bytes_before = state->heap_bytes;
+    /* Baselines; finish_collection turns them into deltas. */
+    event->chunks_visited = state->stats.chunks_visited;
+    event->edges_traced = state->stats.edges_traced;
+    event->chunks_freed = state->stats.chunks_freed;
+    event->bytes_freed = state->stats.bytes_freed;
+}
+
+/* Histogram bucket for a pause: floor(log2(microseconds)), clamped. */
+static size_t pause_bucket(double seconds) {
+    double microseconds = seconds * 1e6;
+    size_t bucket = 0;
+    while (microseconds >= 2.0 && bucket + 1 < PAUSE_HISTOGRAM_BUCKETS) {
+        microseconds /= 2.0;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/*
+ * Close a collection begun with begin_collection: fold its pause into the
+ * totals and histogram, and append it to the event log.
+ */
+static void finish_collection(ProgramState *state, GcEvent *event, const struct timespec *start,
+                              double mark_seconds) {
+    GcStats *stats = &state->stats;
+    double pause = seconds_since(start);
+    event->pause_seconds = pause;
+    event->mark_seconds = mark_seconds;
+    event->sweep_seconds = pause - mark_seconds;
+    event->chunks_visited = stats->chunks_visited - event->chunks_visited;
+    event->edges_traced = stats->edges_traced - event->edges_traced;
+    event->chunks_freed = stats->chunks_freed - event->chunks_freed;
+    event->bytes_freed = stats->bytes_freed - event->bytes_freed;
+    event->chunks_after = state->heap_size + state->nursery_size;
+    event->bytes_after = state->heap_bytes;
+
+    if (event->major) {
+        ++stats->major_collections;
+    } else {
+        ++stats->minor_collections;
+    }
+    stats->mark_seconds += event->mark_seconds;
+    stats->sweep_seconds += event->sweep_seconds;
+    stats->total_seconds += pause;
+    if (pause > stats->max_pause_seconds) {
+        stats->max_pause_seconds = pause;
+    }
+    ++stats->pause_histogram[pause_bucket(pause)];
+    if (stats->event_count == stats->event_capacity) {
+        stats->events = grow_array(stats->events, &stats->event_capacity, stats->event_count + 1,
+                                   sizeof(*stats->events), "event log");
+    }
+    stats->events[stats->event_count++] = *event;
+}
+
+/*
+ * Cheney evacuation: copy a chunk into to_space once and leave a forwarding
+ * pointer behind, so later references to it resolve to the same copy.
+ */
+static HeapChunk *evacuate_chunk(ProgramState *state, HeapChunk *chunk, size_t *to_used) {
+    if (!chunk) {
+        return NULL;
+    }
+    if (chunk->forward) {
+        return chunk->forward;
+    }
+    size_t bytes = chunk_footprint(chunk->reference_capacity);
+    HeapChunk *copy = (HeapChunk *)(state->to_space + *to_used);
+    memcpy(copy, chunk, bytes);
+    copy->references = (HeapChunk **)(copy + 1);
+    copy->forward = NULL;
+    chunk->forward = copy;
+    *to_used += bytes;
+    ++state->stats.chunks_visited;
+    state->heap[state->heap_size++] = copy;
+    return copy;
+}
+
+/*
+ * Semi-space collection: evacuate the roots, then scan to_space breadth-first,
+ * evacuating every referent. Whatever was not copied is garbage.
+ */
+static void copying_collect(ProgramState *state) {
+    size_t to_used = 0;
+    size_t chunks_before = state->heap_size;
+    /* heap[] is rebuilt in copy order; the old entries are all in from-space. */
+    state->heap_size = 0;
+
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        state->stack[i].ref = evacuate_chunk(state, state->stack[i].ref, &to_used);
+    }
+    size_t scan = 0;
+    while (scan < to_used) {
+        HeapChunk *chunk = (HeapChunk *)(state->to_space + scan);
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            if (chunk->references[r]) {
+                ++state->stats.edges_traced;
+                chunk->references[r] = evacuate_chunk(state, chunk->references[r], &to_used);
+            }
+        }
+        scan += chunk_footprint(chunk->reference_capacity);
+    }
+
+    unsigned char *from_space = state->space;
+    state->space = state->to_space;
+    state->to_space = from_space;
+    state->space_used = to_used;
+    state->stats.chunks_freed += chunks_before - state->heap_size;
+    state->stats.bytes_freed += state->heap_bytes - to_used;
+    state->heap_bytes = to_used;
+}
+
+/*
+ * LISP2 sliding compaction after mark_phase: assign each live chunk its
+ * address in a left-packed layout, rewrite every pointer, then slide chunks
+ * down in order.
+ */
+static void compact_phase(ProgramState *state) {
+    size_t chunks_before = state->heap_size;
+    size_t free_offset = 0;
+    for (size_t offset = 0; offset < state->space_used;) {
+        HeapChunk *chunk = (HeapChunk *)(state->space + offset);
+        size_t bytes = chunk_footprint(chunk->reference_capacity);
+        if (chunk->marked) {
+            chunk->forward = (HeapChunk *)(state->space + free_offset);
+            free_offset += bytes;
+        }
+        offset += bytes;
+    }
+
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        if (state->stack[i].ref) {
+            state->stack[i].ref = state->stack[i].ref->forward;
+        }
+    }
+    for (size_t offset = 0; offset < state->space_used;) {
+        HeapChunk *chunk = (HeapChunk *)(state->space + offset);
+        if (chunk->marked) {
+            for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+                if (chunk->references[r]) {
+                    chunk->references[r] = chunk->references[r]->forward;
+                }
+            }
+        }
+        offset += chunk_footprint(chunk->reference_capacity);
+    }
+
+    /* Destinations never overtake sources, so each header is read before it is overwritten. */
+    state->heap_size = 0;
+    for (size_t offset = 0; offset < state->space_used;) {
+        HeapChunk *chunk = (HeapChunk *)(state->space + offset);
+        size_t bytes = chunk_footprint(chunk->reference_capacity);
+        if (chunk->marked) {
+            HeapChunk *destination = chunk->forward;
+            memmove(destination, chunk, bytes);
+            destination->references = (HeapChunk **)(destination + 1);
+            destination->marked = 0;
+            destination->forward = NULL;
+            state->heap[state->heap_size++] = destination;
+        }
+        offset += bytes;
+    }
+    state->space_used = free_offset;
+    state->stats.chunks_freed += chunks_before - state->heap_size;
+    state->stats.bytes_freed += state->heap_bytes - free_offset;
+    state->heap_bytes = free_offset;
+}
+
+/*
+ * Collect only the nursery: trace young chunks from the stack roots and from
+ * the remembered set, free the rest, and promote chunks old enough to tenure.
+ */
+static void run_minor_gc(ProgramState *state) {
+    if (state->collector != COLLECTOR_GENERATIONAL) {
+        run_gc(state);
+        return;
+    }
+
+    struct timespec start;
+    GcEvent event;
+    begin_collection(state, &event, 0, &start);
+
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        mark_young_chunk(state, state->stack[i].ref);
+    }
+    for (size_t i = 0; i < state->remembered_size; ++i) {
+        HeapChunk *chunk = state->remembered[i];
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            mark_young_chunk(state, chunk->references[r]);
+        }
+    }
+    double mark_seconds = seconds_since(&start);
+
+    HeapChunk **promoted = malloc((state->nursery_size + 1) * sizeof(*promoted));
+    if (!promoted) {
+        fprintf(stderr, "Failed to allocate promotion buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t promoted_count = 0;
+    sweep_nursery(state, promoted, &promoted_count);
+
+    prune_remembered_set(state);
+    for (size_t i = 0; i < promoted_count; ++i) {
+        if (has_young_reference(promoted[i])) {
+            remember_chunk(state, promoted[i]);
+        }
+    }
+    free(promoted);
+
+    finish_collection(state, &event, &start, mark_seconds);
+}
+
+/* Full collection over both generations. */
+static void run_major_gc(ProgramState *state) {
+    struct timespec start;
+    GcEvent event;
+    begin_collection(state, &event, 1, &start);
+
+    if (state->collector == COLLECTOR_COPYING) {
+        /* Tracing and copying are one pass; there is no sweep. */
+        copying_collect(state);
+        finish_collection(state, &event, &start, seconds_since(&start));
+        return;
+    }
+
     mark_phase(state);
+    double mark_seconds = seconds_since(&start);
+
+    if (state->collector == COLLECTOR_MARK_COMPACT) {
+        compact_phase(state);
+        finish_collection(state, &event, &start, mark_seconds);
+        return;
+    }
+
+    /* Forget remembered chunks before the sweep can free them. */
+    for (size_t i = 0; i < state->remembered_size; ++i) {
+        state->remembered[i]->remembered = 0;
+    }
+    state->remembered_size = 0;
+
     sweep_phase(state);
+    if (state->collector == COLLECTOR_GENERATIONAL) {
+        HeapChunk **promoted = malloc((state->nursery_size + 1) * sizeof(*promoted));
+        if (!promoted) {
+            fprintf(stderr, "Failed to allocate promotion buffer.\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t promoted_count = 0;
+        sweep_nursery(state, promoted, &promoted_count);
+        free(promoted);
+        for (size_t i = 0; i < state->heap_size; ++i) {
+            if (has_young_reference(state->heap[i])) {
+                remember_chunk(state, state->heap[i]);
+            }
+        }
+    }
+
+    finish_collection(state, &event, &start, mark_seconds);
+}
+
+/* Convenience wrapper that performs mark then sweep. */
+static void run_gc(ProgramState *state) {
+    run_major_gc(state);
+}
+
+/*
+ * Compact view of a heap too large to dump: root, chunk, slot and byte counts
+ * per generation or space.
+ */
+static void print_heap_summary(const ProgramState *state) {
+    size_t live_roots = 0;
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        live_roots += state->stack[i].ref != NULL;
+    }
+    size_t slots = 0;
+    size_t edges = 0;
+    for (size_t i = 0; i < state->heap_size + state->nursery_size; ++i) {
+        const HeapChunk *chunk = i < state->heap_size ? state->heap[i] : state->nursery[i - state->heap_size];
+        slots += chunk->reference_capacity;
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            edges += chunk->references[r] != NULL;
+        }
+    }
+
+    printf("\nStack: %zu roots (%zu non-NULL)\n", state->stack_size, live_roots);
+    printf("Heap: %zu chunks, %zu slots (%zu edges), %zu bytes\n", state->heap_size + state->nursery_size,
+           slots, edges, state->heap_bytes);
+    if (state->collector == COLLECTOR_GENERATIONAL) {
+        printf("  old generation %zu chunks, nursery %zu/%zu chunks, remembered set %zu\n", state->heap_size,
+               state->nursery_size, state->nursery_capacity, state->remembered_size);
+    } else if (is_moving_collector(state)) {
+        printf("  space %zu of %zu bytes used\n", state->space_used, state->space_bytes);
+    }
 }
 
-/* Dump the stack/heap graph for illustration. */
+/* Dump the stack/heap graph for illustration, or summarise a large heap. */
 static void print_state(const ProgramState *state) {
+    if (state->heap_size + state->nursery_size > PRINT_STATE_LIMIT) {
+        print_heap_summary(state);
+        return;
+    }
     puts("\nStack:");
     for (size_t i = 0; i < state->stack_size; ++i) {
         const Var *var = &state->stack[i];
         printf("  %s -> %s\n", var->name, var->ref ? var->ref->label : "NULL");
     }
 
-    puts("\nHeap:");
+    puts(state->collector == COLLECTOR_GENERATIONAL ? "\nOld generation:" : "\nHeap:");
     for (size_t i = 0; i < state->heap_size; ++i) {
         const HeapChunk *chunk = state->heap[i];
-        printf("  %s (marked=%d) refs:", chunk->label, chunk->marked);
+        if (is_moving_collector(state)) {
+            printf("  %s @+%zu refs:", chunk->label, (size_t)((const unsigned char *)chunk - state->space));
+        } else {
+            printf("  %s (marked=%d) refs:", chunk->label, chunk->marked);
+        }
         for (size_t r = 0; r < chunk->reference_capacity; ++r) {
             printf(" %s", chunk->references[r] ? chunk->references[r]->label : "NULL");
         }
         puts("");
     }
+
+    if (state->collector != COLLECTOR_GENERATIONAL) {
+        return;
+    }
+    puts("\nNursery:");
+    for (size_t i = 0; i < state->nursery_size; ++i) {
+        const HeapChunk *chunk = state->nursery[i];
+        printf("  %s (age=%u) refs:", chunk->label, chunk->age);
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            printf(" %s", chunk->references[r] ? chunk->references[r]->label : "NULL");
+        }
+        puts("");
+    }
+    printf("\nRemembered set:");
+    for (size_t i = 0; i < state->remembered_size; ++i) {
+        printf(" %s", state->remembered[i]->label);
+    }
+    puts(state->remembered_size ? "" : " (empty)");
+}
+
+/* Print collection totals, tracing throughput and the pause histogram. */
+static void print_gc_summary(const ProgramState *state) {
+    const GcStats *stats = &state->stats;
+    size_t collections = stats->minor_collections + stats->major_collections;
+    printf("\nGC summary: %zu collections (%zu minor, %zu major)\n", collections, stats->minor_collections,
+           stats->major_collections);
+    if (collections == 0) {
+        return;
+    }
+    printf("  pause total %.3f ms, mean %.3f ms, max %.3f ms\n", stats->total_seconds * 1e3,
+           stats->total_seconds / collections * 1e3, stats->max_pause_seconds * 1e3);
+    printf("  mark %.3f ms, sweep %.3f ms\n", stats->mark_seconds * 1e3, stats->sweep_seconds * 1e3);
+    printf("  traced %zu chunks, %zu edges (%.1f M edges/s)\n", stats->chunks_visited, stats->edges_traced,
+           stats->mark_seconds > 0.0 ? stats->edges_traced / stats->mark_seconds / 1e6 : 0.0);
+    printf("  freed %zu chunks, %zu bytes (%.1f MB/s of pause)\n", stats->chunks_freed, stats->bytes_freed,
+           stats->total_seconds > 0.0 ? stats->bytes_freed / stats->total_seconds / 1e6 : 0.0);
+    const GcEvent *last = &stats->events[stats->event_count - 1];
+    printf("  last collection: %zu -> %zu chunks, %zu -> %zu bytes\n", last->chunks_before, last->chunks_after,
+           last->bytes_before, last->bytes_after);
+
+    size_t tallest = 0;
+    for (size_t b = 0; b < PAUSE_HISTOGRAM_BUCKETS; ++b) {
+        tallest = stats->pause_histogram[b] > tallest ? stats->pause_histogram[b] : tallest;
+    }
+    puts("  pause histogram (us):");
+    for (size_t b = 0; b < PAUSE_HISTOGRAM_BUCKETS; ++b) {
+        size_t count = stats->pause_histogram[b];
+        if (count == 0) {
+            continue;
+        }
+        size_t width = (count * 40 + tallest - 1) / tallest;
+        printf("    %8zu-%-8zu %8zu ", b == 0 ? (size_t)0 : (size_t)1 << b, (size_t)1 << (b + 1), count);
+        for (size_t i = 0; i < width; ++i) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+/* Write one CSV row per collection to path. */
+static void write_gc_events(const ProgramState *state, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fputs("collection,kind,start_ms,pause_ms,mark_ms,sweep_ms,chunks_visited,edges_traced,chunks_freed,"
+          "bytes_freed,chunks_before,chunks_after,bytes_before,bytes_after\n",
+          file);
+    for (size_t i = 0; i < state->stats.event_count; ++i) {
+        const GcEvent *event = &state->stats.events[i];
+        fprintf(file, "%zu,%s,%.4f,%.4f,%.4f,%.4f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n", i,
+                event->major ? "major" : "minor", event->start_seconds * 1e3, event->pause_seconds * 1e3,
+                event->mark_seconds * 1e3, event->sweep_seconds * 1e3, event->chunks_visited,
+                event->edges_traced, event->chunks_freed, event->bytes_freed, event->chunks_before,
+                event->chunks_after, event->bytes_before, event->bytes_after);
+    }
+    if (ferror(file) || fclose(file) != 0) {
+        fprintf(stderr, "Failed to write event log '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
 }
 
 /* Assemble the sample stack roots and heap graph. */
@@ -198,27 +1086,1616 @@ static void build_demo_state(ProgramState *state) {
     update_stack(state, "rootB", beta);
     update_stack(state, "helper", gamma);
 
-    connect_chunks(alpha, 0, beta);
-    connect_chunks(beta, 0, delta);
-    connect_chunks(beta, 1, gamma);
-    connect_chunks(gamma, 0, alpha);
-    connect_chunks(delta, 0, gamma);
+    connect_chunks(state, alpha, 0, beta);
+    connect_chunks(state, beta, 0, delta);
+    connect_chunks(state, beta, 1, gamma);
+    connect_chunks(state, gamma, 0, alpha);
+    connect_chunks(state, delta, 0, gamma);
 
-    connect_chunks(cycle1, 0, cycle2);
-    connect_chunks(cycle2, 0, cycle1);
+    connect_chunks(state, cycle1, 0, cycle2);
+    connect_chunks(state, cycle2, 0, cycle1);
 
     update_stack(state, "helper", NULL);
 }
 
-/* Drive the GC demo: build state, run GC, show before/after. */
-int main(void) {
+/* Generational demo: age the sample graph into the old gen, then add young garbage. */
+static void run_generational_demo(void) {
     ProgramState state = create_program_state(8, 16);
+    enable_generational(&state, 8, 1);
 
     build_demo_state(&state);
+    puts("Initial program state (all chunks in the nursery):");
+    print_state(&state);
 
-    puts("Initial program state:");
+    puts("\nRunning minor collection...");
+    run_minor_gc(&state);
+    puts("\nAfter minor GC (survivors promoted, cycle freed):");
+    print_state(&state);
+
+    /* An old-to-young store goes through the write barrier. */
+    HeapChunk *fresh = allocate_chunk(&state, "fresh", 0);
+    allocate_chunk(&state, "temp", 0);
+    connect_chunks(&state, find_variable(&state, "rootA")->ref, 1, fresh);
+
+    puts("\nAfter allocating fresh (linked from alpha) and unreachable temp:");
     print_state(&state);
 
+    puts("\nRunning minor collection...");
+    run_minor_gc(&state);
+    puts("\nAfter minor GC (fresh kept alive by the remembered set, temp freed):");
+    print_state(&state);
+
+    destroy_program_state(&state);
+}
+
+/* Small xorshift generator so workloads are reproducible across runs. */
+static unsigned long long next_random(unsigned long long *seed) {
+    unsigned long long x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    return x;
+}
+
+/*
+ * Allocation-heavy workload: most chunks die immediately, a few are stored in
+ * a long-lived table (old-to-young stores) and later overwritten.
+ */
+static void run_churn_workload(ProgramState *state, size_t allocations, size_t table_slots,
+                               unsigned survive_percent) {
+    unsigned long long seed = 0x9e3779b97f4a7c15ULL;
+    HeapChunk *table = allocate_chunk(state, "table", table_slots);
+    update_stack(state, "table", table);
+
+    for (size_t i = 0; i < allocations; ++i) {
+        HeapChunk *chunk = allocate_chunk(state, "tmp", 1);
+        update_stack(state, "tmp", chunk);
+        /* Allocation may have moved the table. */
+        table = find_variable(state, "table")->ref;
+
+        /* Young-to-old pointer: needs no barrier. */
+        connect_chunks(state, chunk, 0, table);
+        size_t slot = (size_t)(next_random(&seed) % table_slots);
+        if (next_random(&seed) % 100 < survive_percent) {
+            connect_chunks(state, table, slot, chunk);
+        }
+    }
+}
+
+/* Print one row of the collector comparison table. */
+static void print_comparison_row(const char *name, const GcStats *stats) {
+    size_t collections = stats->minor_collections + stats->major_collections;
+    double mean = collections ? stats->total_seconds / collections : 0.0;
+    printf("%-14s\t%6zu\t%6zu\t%.6f\t%.9f\t%.9f\n",
+           name,
+           stats->minor_collections,
+           stats->major_collections,
+           stats->total_seconds,
+           mean,
+           stats->max_pause_seconds);
+}
+
+/* Run the churn workload under both collectors and compare GC cost. */
+static void compare_collectors(size_t allocations) {
+    const size_t heap_capacity = 8192;
+    const size_t nursery_capacity = 1024;
+    const size_t table_slots = 512;
+    const unsigned survive_percent = 5;
+
+    ProgramState full = create_program_state(8, heap_capacity);
+    run_churn_workload(&full, allocations, table_slots, survive_percent);
+
+    ProgramState generational = create_program_state(8, heap_capacity);
+    enable_generational(&generational, nursery_capacity, DEFAULT_PROMOTION_AGE);
+    run_churn_workload(&generational, allocations, table_slots, survive_percent);
+
+    printf("Churn workload: %zu allocations, %u%% stored in a %zu-slot table\n",
+           allocations, survive_percent, table_slots);
+    puts("Collector     \t Minor\t Major\tTotal s \tMean pause s\tMax pause s");
+    print_comparison_row("mark-sweep", &full.stats);
+    print_comparison_row("generational", &generational.stats);
+
+    destroy_program_state(&full);
+    destroy_program_state(&generational);
+}
+
+/* Result of walking the live graph once in depth-first order. */
+typedef struct LocalityReport {
+    size_t chunks_visited;
+    size_t edges;
+    size_t same_page_edges;
+    double mean_gap_bytes;
+} LocalityReport;
+
+/* Byte distance between two chunk addresses. */
+static size_t address_gap(const HeapChunk *a, const HeapChunk *b) {
+    size_t x = (size_t)a;
+    size_t y = (size_t)b;
+    return x > y ? x - y : y - x;
+}
+
+/*
+ * Walk everything reachable from the roots the way a mutator would and
+ * record how far apart consecutive chunks and edge endpoints live in memory.
+ */
+static LocalityReport measure_locality(ProgramState *state) {
+    LocalityReport report = {0, 0, 0, 0.0};
+    HeapChunk **pending = malloc((state->heap_size + 1) * sizeof(*pending));
+    if (!pending) {
+        fprintf(stderr, "Failed to allocate traversal stack.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t pending_size = 0;
+    const HeapChunk *previous = NULL;
+    double total_gap = 0.0;
+
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        HeapChunk *root = state->stack[i].ref;
+        if (!root || root->marked) {
+            continue;
+        }
+        root->marked = 1;
+        pending[pending_size++] = root;
+        while (pending_size > 0) {
+            HeapChunk *chunk = pending[--pending_size];
+            if (previous) {
+                total_gap += (double)address_gap(previous, chunk);
+            }
+            previous = chunk;
+            ++report.chunks_visited;
+            for (size_t r = chunk->reference_capacity; r-- > 0;) {
+                HeapChunk *target = chunk->references[r];
+                if (!target) {
+                    continue;
+                }
+                ++report.edges;
+                if ((size_t)chunk / LOCALITY_PAGE_SIZE == (size_t)target / LOCALITY_PAGE_SIZE) {
+                    ++report.same_page_edges;
+                }
+                if (!target->marked) {
+                    target->marked = 1;
+                    pending[pending_size++] = target;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < state->heap_size; ++i) {
+        state->heap[i]->marked = 0;
+    }
+    free(pending);
+    if (report.chunks_visited > 1) {
+        report.mean_gap_bytes = total_gap / (double)(report.chunks_visited - 1);
+    }
+    return report;
+}
+
+/*
+ * Fragmenting workload: each cycle stores fresh nodes into random slots of a
+ * rooted table, interleaving short-lived garbage between a node and its child.
+ */
+static void run_scatter_workload(ProgramState *state, size_t table_slots, size_t cycles,
+                                 size_t nodes_per_cycle, size_t garbage_per_node) {
+    unsigned long long seed = 0x2545f4914f6cdd1dULL;
+    update_stack(state, "table", allocate_chunk(state, "table", table_slots));
+
+    for (size_t cycle = 0; cycle < cycles; ++cycle) {
+        for (size_t n = 0; n < nodes_per_cycle; ++n) {
+            size_t slot = (size_t)(next_random(&seed) % table_slots);
+            HeapChunk *node = allocate_chunk(state, "node", 2);
+            connect_chunks(state, find_variable(state, "table")->ref, slot, node);
+            for (size_t g = 0; g < garbage_per_node; ++g) {
+                allocate_chunk(state, "garbage", 2);
+            }
+            HeapChunk *child = allocate_chunk(state, "child", 2);
+            /* Chunks may have moved; reach the node again through its root. */
+            node = find_variable(state, "table")->ref->references[slot];
+            connect_chunks(state, node, 0, child);
+        }
+        run_gc(state);
+    }
+}
+
+/* Time allocating count two-slot chunks into an empty state with no GC. */
+static double measure_allocation_ns(CollectorMode collector, size_t count) {
+    ProgramState state = create_program_state(8, count);
+    if (collector == COLLECTOR_COPYING || collector == COLLECTOR_MARK_COMPACT) {
+        enable_moving(&state, collector, count * chunk_footprint(2));
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < count; ++i) {
+        allocate_chunk(&state, "chunk", 2);
+    }
+    double seconds = seconds_since(&start);
+    destroy_program_state(&state);
+    return seconds * 1e9 / (double)count;
+}
+
+/* Human-readable collector name for reports. */
+static const char *collector_name(CollectorMode collector) {
+    switch (collector) {
+    case COLLECTOR_MARK_SWEEP:
+        return "mark-sweep";
+    case COLLECTOR_GENERATIONAL:
+        return "generational";
+    case COLLECTOR_COPYING:
+        return "copying";
+    case COLLECTOR_MARK_COMPACT:
+        return "mark-compact";
+    }
+    return "unknown";
+}
+
+/* Compare post-GC locality and allocation cost of moving vs. non-moving collectors. */
+static void compare_moving_collectors(size_t cycles) {
+    const size_t heap_capacity = 65536;
+    const size_t table_slots = 4096;
+    const size_t traversals = 50;
+    const CollectorMode collectors[] = {COLLECTOR_MARK_SWEEP, COLLECTOR_COPYING, COLLECTOR_MARK_COMPACT};
+
+    printf("Scatter workload: %zu cycles of %zu nodes, 3 garbage chunks per node\n", cycles, table_slots);
+    puts("Collector     \t  GCs\t  Live\tSame-page %\tMean gap B\tTraverse us\tAlloc ns");
+    for (size_t c = 0; c < sizeof(collectors) / sizeof(collectors[0]); ++c) {
+        ProgramState state = create_program_state(8, heap_capacity);
+        if (collectors[c] != COLLECTOR_MARK_SWEEP) {
+            enable_moving(&state, collectors[c], heap_capacity * chunk_footprint(2) +
+                                                     chunk_footprint(table_slots));
+        }
+        run_scatter_workload(&state, table_slots, cycles, table_slots, 3);
+
+        LocalityReport report = measure_locality(&state);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t t = 0; t < traversals; ++t) {
+            measure_locality(&state);
+        }
+        double traverse_us = seconds_since(&start) * 1e6 / (double)traversals;
+
+        printf("%-14s\t%5zu\t%6zu\t%10.1f\t%10.0f\t%11.1f\t%8.1f\n",
+               collector_name(collectors[c]),
+               state.stats.major_collections,
+               report.chunks_visited,
+               report.edges ? 100.0 * (double)report.same_page_edges / (double)report.edges : 0.0,
+               report.mean_gap_bytes,
+               traverse_us,
+               measure_allocation_ns(collectors[c], heap_capacity));
+        destroy_program_state(&state);
+    }
+}
+
+/* Run the sample graph through a moving collector and show the relocation. */
+static void run_moving_demo(CollectorMode collector) {
+    ProgramState state = create_program_state(8, 16);
+    enable_moving(&state, collector, 16 * chunk_footprint(2));
+
+    build_demo_state(&state);
+    puts("Initial program state (offsets into the allocation space):");
+    print_state(&state);
+
+    printf("\nRunning %s garbage collector...\n", collector_name(collector));
+    run_gc(&state);
+    puts("\nProgram state after GC (live chunks packed from offset 0):");
+    print_state(&state);
+
+    destroy_program_state(&state);
+}
+
+/*
+ * Build roots stack variables whose lists share chunks nodes between them,
+ * starting from tiny capacities, and time setup plus one full collection.
+ */
+static void run_scale_test(size_t roots, size_t chunks) {
+    ProgramState state = create_program_state(8, 16);
+    char name[MAX_NAME_LENGTH];
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t r = 0; r < roots; ++r) {
+        snprintf(name, sizeof(name), "root%zu", r);
+        update_stack(&state, name, NULL);
+    }
+    for (size_t i = 0; i < chunks; ++i) {
+        snprintf(name, sizeof(name), "root%zu", i % roots);
+        HeapChunk *chunk = allocate_chunk(&state, "node", 1);
+        Var *root = find_variable(&state, name);
+        connect_chunks(&state, chunk, 0, root->ref);
+        root->ref = chunk;
+    }
+    double setup_seconds = seconds_since(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_gc(&state);
+    double gc_seconds = seconds_since(&start);
+
+    printf("Roots: %zu, chunks: %zu (list depth %zu)\n", roots, state.heap_size, chunks / roots);
+    printf("Stack capacity %zu, heap capacity %zu, %zu automatic collections\n",
+           state.stack_capacity, state.heap_capacity, state.stats.major_collections - 1);
+    printf("Setup: %.3f s, full GC: %.3f s\n", setup_seconds, gc_seconds);
+    destroy_program_state(&state);
+}
+
+#define SNAPSHOT_MAGIC "GCSNAP1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NULL UINT32_MAX
+
+/*
+ * Binary snapshot layout (host byte order):
+ *   SnapshotHeader
+ *   uint32_t capacity[chunk_count]      chunk table
+ *   uint32_t target[edge_count]         every reference slot in chunk order,
+ *                                       SNAPSHOT_NULL for an empty slot
+ *   SnapshotRoot root[root_count]       root table
+ * Chunk i owns the slots that follow those of chunks 0..i-1, so no per-edge
+ * source index is stored. Labels are not stored; chunks load as "c<index>".
+ */
+typedef struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t chunk_count;
+    uint64_t edge_count;
+    uint64_t root_count;
+} SnapshotHeader;
+
+typedef struct SnapshotRoot {
+    char name[MAX_NAME_LENGTH];
+    uint32_t target;
+} SnapshotRoot;
+
+/* Snapshot arrays, either mapped straight from a file or parsed from text. */
+typedef struct SnapshotView {
+    uint64_t chunk_count;
+    uint64_t edge_count;
+    uint64_t root_count;
+    const uint32_t *capacities;
+    const uint32_t *targets;
+    const SnapshotRoot *roots;
+    const char (*labels)[MAX_NAME_LENGTH];  /* NULL: synthesise "c<index>" */
+} SnapshotView;
+
+/* Write "c<index>" into label without going through printf. */
+static void format_index_label(char *label, uint64_t index) {
+    char digits[24];
+    size_t length = 0;
+    do {
+        digits[length++] = (char)('0' + index % 10);
+        index /= 10;
+    } while (index > 0);
+    label[0] = 'c';
+    for (size_t i = 0; i < length; ++i) {
+        label[i + 1] = digits[length - 1 - i];
+    }
+    label[length + 1] = '\0';
+}
+
+/* Keep a bulk allocation alive until the state is destroyed. */
+static void register_slab(ProgramState *state, void *slab) {
+    if (state->slab_count == state->slab_capacity) {
+        state->slabs = grow_array(state->slabs, &state->slab_capacity, state->slab_count + 1,
+                                  sizeof(*state->slabs), "slab list");
+    }
+    state->slabs[state->slab_count++] = slab;
+}
+
+/* Abort a load with a message naming the snapshot. */
+static void snapshot_error(const char *path, const char *message) {
+    fprintf(stderr, "Invalid snapshot '%s': %s\n", path, message);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Build the heap and roots of an empty ProgramState from a snapshot in a
+ * single pass over the slot array. Non-moving collectors get two slabs (all
+ * headers, all slots); moving collectors get the chunks laid out contiguously
+ * in a fresh allocation space. Loaded chunks start in the old generation.
+ */
+static void build_from_snapshot(ProgramState *state, const SnapshotView *view, const char *path) {
+    uint64_t chunk_count = view->chunk_count;
+    if (chunk_count >= SNAPSHOT_NULL) {
+        snapshot_error(path, "too many chunks");
+    }
+    while (state->heap_capacity < state->heap_size + chunk_count) {
+        grow_heap(state);
+    }
+
+    size_t total_bytes = chunk_count * sizeof(HeapChunk) + view->edge_count * sizeof(HeapChunk *);
+    int moving = is_moving_collector(state);
+    HeapChunk *headers = NULL;
+    HeapChunk **slots = NULL;
+    size_t *offsets = NULL;
+    if (moving) {
+        /* Reserve headroom so the first allocations do not force a collection. */
+        size_t space_bytes = 2 * total_bytes > state->space_bytes ? 2 * total_bytes : state->space_bytes;
+        free(state->space);
+        free(state->to_space);
+        state->space = NULL;
+        state->to_space = NULL;
+        enable_moving(state, state->collector, space_bytes);
+        offsets = malloc((chunk_count + 1) * sizeof(*offsets));
+        if (!offsets) {
+            fprintf(stderr, "Failed to allocate snapshot offsets.\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t offset = 0;
+        uint64_t slot_total = 0;
+        for (uint64_t i = 0; i < chunk_count; ++i) {
+            offsets[i] = offset;
+            offset += chunk_footprint(view->capacities[i]);
+            slot_total += view->capacities[i];
+        }
+        if (slot_total != view->edge_count) {
+            snapshot_error(path, "chunk capacities do not match the edge count");
+        }
+    } else {
+        headers = calloc(chunk_count > 0 ? chunk_count : 1, sizeof(*headers));
+        slots = malloc(view->edge_count > 0 ? view->edge_count * sizeof(*slots) : 1);
+        if (!headers || !slots) {
+            fprintf(stderr, "Failed to allocate snapshot slabs.\n");
+            exit(EXIT_FAILURE);
+        }
+        register_slab(state, headers);
+        register_slab(state, slots);
+    }
+
+    uint64_t cursor = 0;
+    for (uint64_t i = 0; i < chunk_count; ++i) {
+        size_t capacity = view->capacities[i];
+        if (cursor + capacity > view->edge_count) {
+            snapshot_error(path, "chunk capacities exceed the edge count");
+        }
+        HeapChunk *chunk;
+        if (moving) {
+            chunk = (HeapChunk *)(state->space + offsets[i]);
+            memset(chunk, 0, sizeof(*chunk));
+            chunk->references = (HeapChunk **)(chunk + 1);
+        } else {
+            chunk = &headers[i];
+            chunk->references = slots + cursor;
+            chunk->slab_backed = 1;
+        }
+        if (view->labels) {
+            memcpy(chunk->label, view->labels[i], sizeof(chunk->label));
+            chunk->label[sizeof(chunk->label) - 1] = '\0';
+        } else {
+            format_index_label(chunk->label, i);
+        }
+        chunk->generation = GENERATION_OLD;
+        chunk->reference_capacity = capacity;
+
+        const uint32_t *targets = view->targets + cursor;
+        for (size_t r = 0; r < capacity; ++r) {
+            uint32_t target = targets[r];
+            if (target == SNAPSHOT_NULL) {
+                chunk->references[r] = NULL;
+            } else if (target < chunk_count) {
+                chunk->references[r] = moving ? (HeapChunk *)(state->space + offsets[target]) : &headers[target];
+            } else {
+                snapshot_error(path, "edge target out of range");
+            }
+        }
+        cursor += capacity;
+        state->heap[state->heap_size++] = chunk;
+    }
+    if (cursor != view->edge_count) {
+        snapshot_error(path, "chunk capacities do not match the edge count");
+    }
+    state->heap_bytes += total_bytes;
+    if (moving) {
+        state->space_used = total_bytes;
+    }
+
+    for (uint64_t i = 0; i < view->root_count; ++i) {
+        SnapshotRoot root;
+        memcpy(&root, &view->roots[i], sizeof(root));
+        root.name[MAX_NAME_LENGTH - 1] = '\0';
+        HeapChunk *target = NULL;
+        if (root.target != SNAPSHOT_NULL) {
+            if (root.target >= chunk_count) {
+                snapshot_error(path, "root target out of range");
+            }
+            target = moving ? (HeapChunk *)(state->space + offsets[root.target]) : &headers[root.target];
+        }
+        update_stack(state, root.name, target);
+    }
+    free(offsets);
+}
+
+/* Label-to-index table used while importing text snapshots. */
+typedef struct LabelIndex {
+    char (*labels)[MAX_NAME_LENGTH];
+    size_t *slots;          /* index + 1, or 0 when empty */
+    size_t slot_capacity;
+} LabelIndex;
+
+/* Slot holding label, or the empty slot where it belongs. */
+static size_t find_label_slot(const LabelIndex *index, const char *label) {
+    size_t mask = index->slot_capacity - 1;
+    size_t slot = hash_name(label) & mask;
+    while (index->slots[slot] != 0 && strcmp(index->labels[index->slots[slot] - 1], label) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Rebuild the label table at double size for count entries. */
+static void grow_label_index(LabelIndex *index, size_t count) {
+    index->slot_capacity = index->slot_capacity ? index->slot_capacity * 2 : 1024;
+    free(index->slots);
+    index->slots = calloc(index->slot_capacity, sizeof(*index->slots));
+    if (!index->slots) {
+        fprintf(stderr, "Failed to allocate label index.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        index->slots[find_label_slot(index, index->labels[i])] = i + 1;
+    }
+}
+
+/*
+ * Parse a decimal count from a text snapshot into *value. Returns 0 unless
+ * the whole field is digits and the number is at most max.
+ */
+static int parse_snapshot_count(const char *text, unsigned long max, unsigned long *value) {
+    char *end;
+    if (text[0] < '0' || text[0] > '9') {
+        return 0;
+    }
+    errno = 0;
+    *value = strtoul(text, &end, 10);
+    return errno == 0 && *end == '\0' && *value <= max;
+}
+
+/*
+ * Import a text snapshot, one record per line ('#' starts a comment):
+ *   chunk <id> <capacity> [label]
+ *   edge <from-id> <slot> <to-id>
+ *   root <name> <id|NULL>
+ * Ids must be declared by a chunk line before an edge or root uses them.
+ */
+static void load_text_snapshot(ProgramState *state, FILE *file, const char *path) {
+    char (*ids)[MAX_NAME_LENGTH] = NULL;
+    char (*labels)[MAX_NAME_LENGTH] = NULL;
+    uint32_t *capacities = NULL;
+    size_t chunk_count = 0;
+    size_t chunk_capacity = 0;
+    size_t label_capacity = 0;
+    size_t id_capacity = 0;
+    uint32_t *edges = NULL;     /* (from, slot, to) triples */
+    size_t edge_count = 0;
+    size_t edge_capacity = 0;
+    SnapshotRoot *roots = NULL;
+    size_t root_count = 0;
+    size_t root_capacity = 0;
+    LabelIndex index = {NULL, NULL, 0};
+
+    char line[256];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        ++line_number;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char kind[16];
+        char first[MAX_NAME_LENGTH];
+        char second[MAX_NAME_LENGTH];
+        char third[MAX_NAME_LENGTH];
+        int fields = sscanf(line, "%15s %31s %31s %31s", kind, first, second, third);
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (strcmp(kind, "chunk") == 0 && fields >= 3) {
+            if (2 * (chunk_count + 1) > index.slot_capacity) {
+                index.labels = ids;
+                grow_label_index(&index, chunk_count);
+            }
+            size_t slot = find_label_slot(&index, first);
+            if (index.slots[slot] != 0) {
+                fprintf(stderr, "%s:%zu: duplicate chunk id %s\n", path, line_number, first);
+                exit(EXIT_FAILURE);
+            }
+            /* The binary format stores each capacity as a uint32_t; hold text snapshots to the same limit. */
+            unsigned long capacity;
+            if (!parse_snapshot_count(second, UINT32_MAX, &capacity)) {
+                fprintf(stderr, "%s:%zu: bad chunk capacity %s\n", path, line_number, second);
+                exit(EXIT_FAILURE);
+            }
+            if (chunk_count == chunk_capacity) {
+                capacities = grow_array(capacities, &chunk_capacity, chunk_count + 1, sizeof(*capacities),
+                                        "chunk table");
+            }
+            ids = grow_array(ids, &id_capacity, chunk_count + 1, sizeof(*ids), "chunk ids");
+            labels = grow_array(labels, &label_capacity, chunk_count + 1, sizeof(*labels), "chunk labels");
+            index.labels = ids;
+            strcpy(ids[chunk_count], first);
+            strcpy(labels[chunk_count], fields >= 4 ? third : first);
+            capacities[chunk_count] = (uint32_t)capacity;
+            index.slots[slot] = ++chunk_count;
+        } else if (strcmp(kind, "edge") == 0 && fields == 4) {
+            size_t from = index.slot_capacity ? index.slots[find_label_slot(&index, first)] : 0;
+            size_t to = index.slot_capacity ? index.slots[find_label_slot(&index, third)] : 0;
+            unsigned long slot;
+            if (from == 0 || to == 0 || !parse_snapshot_count(second, UINT32_MAX, &slot) ||
+                slot >= capacities[from - 1]) {
+                fprintf(stderr, "%s:%zu: bad edge\n", path, line_number);
+                exit(EXIT_FAILURE);
+            }
+            if (3 * (edge_count + 1) > edge_capacity) {
+                edges = grow_array(edges, &edge_capacity, 3 * (edge_count + 1), sizeof(*edges), "edge list");
+            }
+            edges[3 * edge_count] = (uint32_t)(from - 1);
+            edges[3 * edge_count + 1] = (uint32_t)slot;
+            edges[3 * edge_count + 2] = (uint32_t)(to - 1);
+            ++edge_count;
+        } else if (strcmp(kind, "root") == 0 && fields == 3) {
+            uint32_t target = SNAPSHOT_NULL;
+            if (strcmp(second, "NULL") != 0) {
+                size_t found = index.slot_capacity ? index.slots[find_label_slot(&index, second)] : 0;
+                if (found == 0) {
+                    fprintf(stderr, "%s:%zu: unknown chunk id %s\n", path, line_number, second);
+                    exit(EXIT_FAILURE);
+                }
+                target = (uint32_t)(found - 1);
+            }
+            if (root_count == root_capacity) {
+                roots = grow_array(roots, &root_capacity, root_count + 1, sizeof(*roots), "root table");
+            }
+            memset(&roots[root_count], 0, sizeof(roots[root_count]));
+            strcpy(roots[root_count].name, first);
+            roots[root_count].target = target;
+            ++root_count;
+        } else {
+            fprintf(stderr, "%s:%zu: unrecognised line\n", path, line_number);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Lay the edges out as the slot array the binary format uses. */
+    size_t *first_slot = malloc((chunk_count + 1) * sizeof(*first_slot));
+    if (!first_slot) {
+        fprintf(stderr, "Failed to allocate slot offsets.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t slot_count = 0;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        first_slot[i] = slot_count;
+        slot_count += capacities[i];
+    }
+    uint32_t *targets = malloc((slot_count + 1) * sizeof(*targets));
+    if (!targets) {
+        fprintf(stderr, "Failed to allocate slot array.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < slot_count; ++i) {
+        targets[i] = SNAPSHOT_NULL;
+    }
+    for (size_t e = 0; e < edge_count; ++e) {
+        targets[first_slot[edges[3 * e]] + edges[3 * e + 1]] = edges[3 * e + 2];
+    }
+
+    SnapshotView view = {chunk_count, slot_count, root_count, capacities, targets, roots,
+                         (const char (*)[MAX_NAME_LENGTH])labels};
+    build_from_snapshot(state, &view, path);
+
+    free(first_slot);
+    free(targets);
+    free(edges);
+    free(roots);
+    free(ids);
+    free(labels);
+    free(capacities);
+    free(index.slots);
+}
+
+/*
+ * Load a snapshot into an empty ProgramState. Binary snapshots are mapped and
+ * read in place; anything without the magic number is parsed as text.
+ */
+static void load_snapshot(ProgramState *state, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = (size_t)info.st_size;
+
+    SnapshotHeader header;
+    if (size < sizeof(header) || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        FILE *file = fdopen(fd, "r");
+        if (!file) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        load_text_snapshot(state, file, path);
+        fclose(file);
+        return;
+    }
+
+    if (header.version != SNAPSHOT_VERSION) {
+        snapshot_error(path, "unsupported version");
+    }
+    /* Bound each count by the file size first so the products below cannot overflow. */
+    if (header.chunk_count > size / sizeof(uint32_t) || header.edge_count > size / sizeof(uint32_t) ||
+        header.root_count > size / sizeof(SnapshotRoot)) {
+        snapshot_error(path, "file size does not match the header");
+    }
+    uint64_t expected = sizeof(header) + header.chunk_count * sizeof(uint32_t) +
+                        header.edge_count * sizeof(uint32_t) + header.root_count * sizeof(SnapshotRoot);
+    if (expected != size) {
+        snapshot_error(path, "file size does not match the header");
+    }
+
+    unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+    const uint32_t *capacities = (const uint32_t *)(data + sizeof(header));
+    const uint32_t *targets = capacities + header.chunk_count;
+    SnapshotView view = {header.chunk_count, header.edge_count, header.root_count, capacities, targets,
+                         (const SnapshotRoot *)(targets + header.edge_count), NULL};
+    build_from_snapshot(state, &view, path);
+
+    munmap(data, size);
+    close(fd);
+}
+
+/* Pointer-to-index table used while dumping. */
+typedef struct ChunkIndex {
+    const HeapChunk **keys;
+    uint32_t *values;
+    size_t capacity;
+} ChunkIndex;
+
+/* Hash a chunk address (fibonacci hashing on the pointer bits). */
+static size_t chunk_slot(const ChunkIndex *index, const HeapChunk *chunk) {
+    size_t slot = (size_t)(((uint64_t)(uintptr_t)chunk >> 4) * 0x9e3779b97f4a7c15ULL) & (index->capacity - 1);
+    while (index->keys[slot] && index->keys[slot] != chunk) {
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return slot;
+}
+
+/* Snapshot index of a chunk, or SNAPSHOT_NULL. */
+static uint32_t chunk_index_of(const ChunkIndex *index, const HeapChunk *chunk) {
+    if (!chunk) {
+        return SNAPSHOT_NULL;
+    }
+    size_t slot = chunk_slot(index, chunk);
+    return index->keys[slot] ? index->values[slot] : SNAPSHOT_NULL;
+}
+
+/* Chunk number i across the old generation followed by the nursery. */
+static const HeapChunk *snapshot_chunk(const ProgramState *state, size_t i) {
+    return i < state->heap_size ? state->heap[i] : state->nursery[i - state->heap_size];
+}
+
+/* Number every chunk in heap-then-nursery order. */
+static ChunkIndex build_chunk_index(const ProgramState *state) {
+    size_t count = state->heap_size + state->nursery_size;
+    ChunkIndex index;
+    index.capacity = 16;
+    while (index.capacity < 2 * count) {
+        index.capacity *= 2;
+    }
+    index.keys = calloc(index.capacity, sizeof(*index.keys));
+    index.values = malloc(index.capacity * sizeof(*index.values));
+    if (!index.keys || !index.values) {
+        fprintf(stderr, "Failed to allocate chunk index.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const HeapChunk *chunk = snapshot_chunk(state, i);
+        size_t slot = chunk_slot(&index, chunk);
+        index.keys[slot] = chunk;
+        index.values[slot] = (uint32_t)i;
+    }
+    return index;
+}
+
+/* Open path for writing with a large stdio buffer. */
+static FILE *open_dump(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+    return file;
+}
+
+/* Flush and close a dump, exiting on write errors. */
+static void close_dump(FILE *file, const char *path) {
+    if (ferror(file) || fclose(file) != 0) {
+        fprintf(stderr, "Failed to write snapshot '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Write the current heap (both generations) and roots as a binary snapshot. */
+static void dump_snapshot(const ProgramState *state, const char *path) {
+    size_t count = state->heap_size + state->nursery_size;
+    ChunkIndex index = build_chunk_index(state);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.chunk_count = count;
+    header.root_count = state->stack_size;
+    for (size_t i = 0; i < count; ++i) {
+        header.edge_count += snapshot_chunk(state, i)->reference_capacity;
+    }
+
+    FILE *file = open_dump(path);
+    fwrite(&header, sizeof(header), 1, file);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t capacity = (uint32_t)snapshot_chunk(state, i)->reference_capacity;
+        fwrite(&capacity, sizeof(capacity), 1, file);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const HeapChunk *chunk = snapshot_chunk(state, i);
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            uint32_t target = chunk_index_of(&index, chunk->references[r]);
+            fwrite(&target, sizeof(target), 1, file);
+        }
+    }
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        SnapshotRoot root;
+        memset(&root, 0, sizeof(root));
+        memcpy(root.name, state->stack[i].name, sizeof(root.name) - 1);
+        root.target = chunk_index_of(&index, state->stack[i].ref);
+        fwrite(&root, sizeof(root), 1, file);
+    }
+    close_dump(file, path);
+    free(index.keys);
+    free(index.values);
+}
+
+/* Write the current heap and roots in the text snapshot format. */
+static void dump_text_snapshot(const ProgramState *state, const char *path) {
+    size_t count = state->heap_size + state->nursery_size;
+    ChunkIndex index = build_chunk_index(state);
+
+    FILE *file = open_dump(path);
+    fprintf(file, "# mark_sweep heap snapshot: %zu chunks, %zu roots\n", count, state->stack_size);
+    for (size_t i = 0; i < count; ++i) {
+        const HeapChunk *chunk = snapshot_chunk(state, i);
+        fprintf(file, "chunk %zu %zu %s\n", i, chunk->reference_capacity,
+                chunk->label[0] ? chunk->label : "-");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const HeapChunk *chunk = snapshot_chunk(state, i);
+        for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+            uint32_t target = chunk_index_of(&index, chunk->references[r]);
+            if (target != SNAPSHOT_NULL) {
+                fprintf(file, "edge %zu %zu %u\n", i, r, target);
+            }
+        }
+    }
+    for (size_t i = 0; i < state->stack_size; ++i) {
+        uint32_t target = chunk_index_of(&index, state->stack[i].ref);
+        if (target == SNAPSHOT_NULL) {
+            fprintf(file, "root %s NULL\n", state->stack[i].name);
+        } else {
+            fprintf(file, "root %s %u\n", state->stack[i].name, target);
+        }
+    }
+    close_dump(file, path);
+    free(index.keys);
+    free(index.values);
+}
+
+typedef enum WorkloadShape {
+    SHAPE_RANDOM,       /* random spanning tree plus random extra edges */
+    SHAPE_LIST,         /* singly linked chains of chain_depth chunks */
+    SHAPE_TREE,         /* complete trees of height chain_depth */
+    SHAPE_POWER_LAW     /* heavy-tailed fan-out with preferential extra edges */
+} WorkloadShape;
+
+typedef enum FanoutDistribution {
+    FANOUT_FIXED,       /* every chunk gets max_fanout slots */
+    FANOUT_UNIFORM,     /* uniform in [0, max_fanout] */
+    FANOUT_POWER_LAW    /* Pareto tail: P(fan-out >= k) ~ 1/k, capped at max_fanout */
+} FanoutDistribution;
+
+/* Parameters of one synthetic allocation/GC benchmark run. */
+typedef struct WorkloadConfig {
+    CollectorMode collector;
+    WorkloadShape shape;
+    FanoutDistribution fanout_distribution;
+    size_t chunks;          /* chunks allocated per cycle */
+    size_t max_fanout;
+    double live_fraction;   /* share of each cycle's chunks reachable at its end */
+    double cycle_density;   /* chance a spare slot holds a back edge */
+    size_t chain_depth;     /* list length or tree height */
+    size_t roots;           /* stack variables anchoring the live graph */
+    size_t cycles;
+    size_t nursery;         /* generational nursery slots */
+    unsigned promotion_age;
+    unsigned long long seed;
+    const char *dump_path;  /* binary snapshot of the final heap, or NULL */
+    const char *events_path; /* per-collection CSV log, or NULL */
+} WorkloadConfig;
+
+/* Uniform double in [0, 1). */
+static double next_unit(unsigned long long *seed) {
+    return (double)(next_random(seed) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Draw a chunk fan-out from the configured distribution. */
+static size_t draw_fanout(const WorkloadConfig *config, unsigned long long *seed) {
+    switch (config->fanout_distribution) {
+    case FANOUT_FIXED:
+        return config->max_fanout;
+    case FANOUT_UNIFORM:
+        return (size_t)(next_random(seed) % (config->max_fanout + 1));
+    case FANOUT_POWER_LAW: {
+        double u = 1.0 - next_unit(seed);
+        double k = 1.0 / u;
+        return k >= (double)config->max_fanout ? config->max_fanout : (size_t)k;
+    }
+    }
+    return config->max_fanout;
+}
+
+/* Current chunk held by a stack variable (re-read after every allocation). */
+static HeapChunk *root_chunk(ProgramState *state, const char *name) {
+    return find_variable(state, name)->ref;
+}
+
+/*
+ * Allocate one cycle's chunks, interleaving live and garbage chunks, and leave
+ * the live share hanging off the roots in the configured shape. The previous
+ * cycle's graph becomes garbage as the roots are overwritten.
+ *
+ * Every chunk is stored in a rooted "build" or "scratch" table as soon as it is
+ * allocated, and reloaded from there, so collections triggered by allocation
+ * (including moving ones) never leave the generator with a stale pointer.
+ */
+static void generate_workload_cycle(ProgramState *state, const WorkloadConfig *config,
+                                    unsigned long long *seed) {
+    size_t live = (size_t)((double)config->chunks * config->live_fraction + 0.5);
+    live = live > config->chunks ? config->chunks : live;
+    size_t garbage = config->chunks - live;
+    size_t depth = config->chain_depth > 0 ? config->chain_depth : 1;
+    size_t branching = config->max_fanout >= 2 ? config->max_fanout : 2;
+    char name[MAX_NAME_LENGTH];
+
+    /* Number of live chunks that hang directly off a root. */
+    size_t tree_size = 1;
+    size_t attached = 0;
+    if (config->shape == SHAPE_LIST) {
+        attached = (live + depth - 1) / depth;
+    } else if (config->shape == SHAPE_TREE) {
+        for (size_t level = 0, width = 1; level < depth && tree_size < live; ++level) {
+            width *= branching;
+            tree_size += width;
+        }
+        tree_size = tree_size < live ? tree_size : (live > 0 ? live : 1);
+        attached = (live + tree_size - 1) / tree_size;
+    } else {
+        attached = live < config->roots ? live : config->roots;
+    }
+
+    /* With more attachment points than roots, each root owns an anchor chunk. */
+    size_t per_anchor = 0;
+    if (attached > config->roots) {
+        per_anchor = (attached + config->roots - 1) / config->roots;
+        for (size_t r = 0; r < config->roots; ++r) {
+            snprintf(name, sizeof(name), "root%zu", r);
+            update_stack(state, name, allocate_chunk(state, "anchor", per_anchor));
+        }
+    }
+    update_stack(state, "build", allocate_chunk(state, "build", live));
+    update_stack(state, "scratch", allocate_chunk(state, "scratch", garbage));
+
+    /* Open (chunk, slot) pairs that can adopt children in the random shapes. */
+    size_t *open_slots = NULL;
+    size_t open_count = 0;
+    size_t open_capacity = 0;
+    /* Edge targets, sampled to pick power-law extra edges by in-degree. */
+    size_t *endpoints = NULL;
+    size_t endpoint_count = 0;
+    size_t endpoint_capacity = 0;
+
+    size_t live_index = 0;
+    size_t garbage_index = 0;
+    size_t attached_index = 0;
+    for (size_t i = 0; i < config->chunks; ++i) {
+        int is_live = (i + 1) * live / config->chunks > i * live / config->chunks;
+
+        if (!is_live) {
+            HeapChunk *chunk = allocate_chunk(state, "garbage", draw_fanout(config, seed));
+            HeapChunk *scratch = root_chunk(state, "scratch");
+            HeapChunk *build = root_chunk(state, "build");
+            connect_chunks(state, scratch, garbage_index, chunk);
+            for (size_t r = 0; r < chunk->reference_capacity; ++r) {
+                if (garbage_index > 0 && next_unit(seed) < config->cycle_density) {
+                    size_t target = (size_t)(next_random(seed) % garbage_index);
+                    connect_chunks(state, chunk, r, scratch->references[target]);
+                } else if (live_index > 0 && next_unit(seed) < 0.5) {
+                    size_t target = (size_t)(next_random(seed) % live_index);
+                    connect_chunks(state, chunk, r, build->references[target]);
+                }
+            }
+            ++garbage_index;
+            continue;
+        }
+
+        size_t j = live_index;
+        size_t structural = 0;
+        int from_root = 0;
+        size_t parent = 0;
+        size_t parent_slot = 0;
+        if (config->shape == SHAPE_LIST) {
+            structural = 1;
+            from_root = j % depth == 0;
+            parent = j - 1;
+        } else if (config->shape == SHAPE_TREE) {
+            structural = branching;
+            size_t position = j % tree_size;
+            from_root = position == 0;
+            parent = j - position + (position - 1) / branching;
+            parent_slot = (position - 1) % branching;
+        } else {
+            /* Slot 0 always stays open, so the pool never runs dry. */
+            structural = 1;
+            from_root = j < attached || open_count == 0;
+            if (!from_root) {
+                size_t pick = (size_t)(next_random(seed) % open_count);
+                parent = open_slots[2 * pick];
+                parent_slot = open_slots[2 * pick + 1];
+                --open_count;
+                open_slots[2 * pick] = open_slots[2 * open_count];
+                open_slots[2 * pick + 1] = open_slots[2 * open_count + 1];
+            }
+        }
+
+        size_t fanout = draw_fanout(config, seed);
+        HeapChunk *chunk = allocate_chunk(state, "live", fanout > structural ? fanout : structural);
+        HeapChunk *build = root_chunk(state, "build");
+        connect_chunks(state, build, j, chunk);
+
+        if (from_root) {
+            if (per_anchor > 0) {
+                snprintf(name, sizeof(name), "root%zu", attached_index % config->roots);
+                connect_chunks(state, root_chunk(state, name), attached_index / config->roots, chunk);
+            } else {
+                snprintf(name, sizeof(name), "root%zu", attached_index);
+                update_stack(state, name, chunk);
+            }
+            ++attached_index;
+        } else {
+            connect_chunks(state, build->references[parent], parent_slot, chunk);
+            if (endpoint_count == endpoint_capacity) {
+                endpoints = grow_array(endpoints, &endpoint_capacity, endpoint_count + 1,
+                                       sizeof(*endpoints), "endpoint list");
+            }
+            endpoints[endpoint_count++] = j;
+        }
+
+        /* Spare slots: back edges to earlier live chunks, or open for children. */
+        int random_shape = config->shape == SHAPE_RANDOM || config->shape == SHAPE_POWER_LAW;
+        for (size_t r = random_shape ? 0 : structural; r < chunk->reference_capacity; ++r) {
+            if (j > 0 && (r > 0 || !random_shape) && next_unit(seed) < config->cycle_density) {
+                size_t target = (size_t)(next_random(seed) % j);
+                if (config->shape == SHAPE_POWER_LAW && endpoint_count > 0) {
+                    target = endpoints[next_random(seed) % endpoint_count];
+                }
+                connect_chunks(state, chunk, r, build->references[target]);
+            } else if (random_shape) {
+                if (2 * (open_count + 1) > open_capacity) {
+                    open_slots = grow_array(open_slots, &open_capacity, 2 * (open_count + 1),
+                                            sizeof(*open_slots), "open slot pool");
+                }
+                open_slots[2 * open_count] = j;
+                open_slots[2 * open_count + 1] = r;
+                ++open_count;
+            }
+        }
+        ++live_index;
+    }
+
+    free(open_slots);
+    free(endpoints);
+    update_stack(state, "build", NULL);
+    update_stack(state, "scratch", NULL);
+}
+
+/* Sort helper for pause percentiles. */
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of an ascending array. */
+static double percentile(const double *sorted, size_t count, double fraction) {
+    if (count == 0) {
+        return 0.0;
+    }
+    size_t rank = (size_t)(fraction * (double)count + 0.999999);
+    rank = rank == 0 ? 1 : (rank > count ? count : rank);
+    return sorted[rank - 1];
+}
+
+static const char *shape_name(WorkloadShape shape) {
+    switch (shape) {
+    case SHAPE_RANDOM:
+        return "random";
+    case SHAPE_LIST:
+        return "list";
+    case SHAPE_TREE:
+        return "tree";
+    case SHAPE_POWER_LAW:
+        return "powerlaw";
+    }
+    return "unknown";
+}
+
+static const char *fanout_name(FanoutDistribution distribution) {
+    switch (distribution) {
+    case FANOUT_FIXED:
+        return "fixed";
+    case FANOUT_UNIFORM:
+        return "uniform";
+    case FANOUT_POWER_LAW:
+        return "powerlaw";
+    }
+    return "unknown";
+}
+
+/*
+ * Run config->cycles allocation/GC cycles and print one summary record: total
+ * mark and sweep time, pause percentiles over every collection (including
+ * those triggered by allocation), bytes reclaimed and peak RSS.
+ */
+static void run_benchmark(const WorkloadConfig *config, int json, int header) {
+    ProgramState state = create_program_state(config->roots + 2, 1024);
+    if (config->collector == COLLECTOR_GENERATIONAL) {
+        enable_generational(&state, config->nursery, config->promotion_age);
+    } else if (config->collector == COLLECTOR_COPYING || config->collector == COLLECTOR_MARK_COMPACT) {
+        enable_moving(&state, config->collector, 1 << 20);
+    }
+    char name[MAX_NAME_LENGTH];
+    for (size_t r = 0; r < config->roots; ++r) {
+        snprintf(name, sizeof(name), "root%zu", r);
+        update_stack(&state, name, NULL);
+    }
+
+    unsigned long long seed = config->seed ? config->seed : 1;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t cycle = 0; cycle < config->cycles; ++cycle) {
+        generate_workload_cycle(&state, config, &seed);
+        run_gc(&state);
+    }
+    double wall_seconds = seconds_since(&start);
+    if (config->dump_path) {
+        dump_snapshot(&state, config->dump_path);
+    }
+    if (config->events_path) {
+        write_gc_events(&state, config->events_path);
+    }
+
+    const GcStats *stats = &state.stats;
+    double *sorted = malloc((stats->event_count + 1) * sizeof(*sorted));
+    if (!sorted) {
+        fprintf(stderr, "Failed to allocate pause buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < stats->event_count; ++i) {
+        sorted[i] = stats->events[i].pause_seconds;
+    }
+    qsort(sorted, stats->event_count, sizeof(*sorted), compare_doubles);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double p50 = percentile(sorted, stats->event_count, 0.50) * 1e3;
+    double p90 = percentile(sorted, stats->event_count, 0.90) * 1e3;
+    double p99 = percentile(sorted, stats->event_count, 0.99) * 1e3;
+    double max = percentile(sorted, stats->event_count, 1.0) * 1e3;
+    if (json) {
+        printf("{\"collector\":\"%s\",\"shape\":\"%s\",\"fanout_dist\":\"%s\",\"chunks\":%zu,"
+               "\"max_fanout\":%zu,\"live_fraction\":%.3f,\"cycle_density\":%.3f,\"chain_depth\":%zu,"
+               "\"roots\":%zu,\"cycles\":%zu,\"collections\":%zu,\"wall_ms\":%.3f,\"mark_ms\":%.3f,"
+               "\"sweep_ms\":%.3f,\"pause_p50_ms\":%.4f,\"pause_p90_ms\":%.4f,\"pause_p99_ms\":%.4f,"
+               "\"pause_max_ms\":%.4f,\"chunks_reclaimed\":%zu,\"bytes_reclaimed\":%zu,"
+               "\"peak_rss_kb\":%ld}\n",
+               collector_name(config->collector), shape_name(config->shape),
+               fanout_name(config->fanout_distribution), config->chunks, config->max_fanout,
+               config->live_fraction, config->cycle_density, config->chain_depth, config->roots,
+               config->cycles, stats->event_count, wall_seconds * 1e3, stats->mark_seconds * 1e3,
+               stats->sweep_seconds * 1e3, p50, p90, p99, max, stats->chunks_freed, stats->bytes_freed,
+               usage.ru_maxrss);
+    } else {
+        if (header) {
+            puts("collector,shape,fanout_dist,chunks,max_fanout,live_fraction,cycle_density,chain_depth,"
+                 "roots,cycles,collections,wall_ms,mark_ms,sweep_ms,pause_p50_ms,pause_p90_ms,"
+                 "pause_p99_ms,pause_max_ms,chunks_reclaimed,bytes_reclaimed,peak_rss_kb");
+        }
+        printf("%s,%s,%s,%zu,%zu,%.3f,%.3f,%zu,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.4f,%zu,%zu,%ld\n",
+               collector_name(config->collector), shape_name(config->shape),
+               fanout_name(config->fanout_distribution), config->chunks, config->max_fanout,
+               config->live_fraction, config->cycle_density, config->chain_depth, config->roots,
+               config->cycles, stats->event_count, wall_seconds * 1e3, stats->mark_seconds * 1e3,
+               stats->sweep_seconds * 1e3, p50, p90, p99, max, stats->chunks_freed, stats->bytes_freed,
+               usage.ru_maxrss);
+    }
+
+    free(sorted);
+    destroy_program_state(&state);
+}
+
+/* Return the value of a --key=value option, or NULL if arg is another option. */
+static const char *option_value(const char *arg, const char *key) {
+    size_t length = strlen(key);
+    if (strncmp(arg, key, length) == 0 && arg[length] == '=') {
+        return arg + length + 1;
+    }
+    return NULL;
+}
+
+/* Parse a --collector value; returns 0 if the name is unknown. */
+static int parse_collector(const char *value, CollectorMode *collector) {
+    if (strcmp(value, "mark-sweep") == 0) {
+        *collector = COLLECTOR_MARK_SWEEP;
+    } else if (strcmp(value, "generational") == 0) {
+        *collector = COLLECTOR_GENERATIONAL;
+    } else if (strcmp(value, "copying") == 0) {
+        *collector = COLLECTOR_COPYING;
+    } else if (strcmp(value, "mark-compact") == 0) {
+        *collector = COLLECTOR_MARK_COMPACT;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* Parse --bench options into config; returns 0 and prints usage on error. */
+static int parse_benchmark_options(int argc, char **argv, WorkloadConfig *config, int *json, int *header) {
+    int i = 2;
+    for (; i < argc; ++i) {
+        const char *value = NULL;
+        if ((value = option_value(argv[i], "--collector"))) {
+            if (!parse_collector(value, &config->collector)) {
+                break;
+            }
+        } else if ((value = option_value(argv[i], "--shape"))) {
+            if (strcmp(value, "random") == 0) {
+                config->shape = SHAPE_RANDOM;
+            } else if (strcmp(value, "list") == 0) {
+                config->shape = SHAPE_LIST;
+            } else if (strcmp(value, "tree") == 0) {
+                config->shape = SHAPE_TREE;
+            } else if (strcmp(value, "powerlaw") == 0) {
+                config->shape = SHAPE_POWER_LAW;
+            } else {
+                break;
+            }
+        } else if ((value = option_value(argv[i], "--fanout-dist"))) {
+            if (strcmp(value, "fixed") == 0) {
+                config->fanout_distribution = FANOUT_FIXED;
+            } else if (strcmp(value, "uniform") == 0) {
+                config->fanout_distribution = FANOUT_UNIFORM;
+            } else if (strcmp(value, "powerlaw") == 0) {
+                config->fanout_distribution = FANOUT_POWER_LAW;
+            } else {
+                break;
+            }
+        } else if ((value = option_value(argv[i], "--chunks"))) {
+            config->chunks = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--fanout"))) {
+            config->max_fanout = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--live"))) {
+            config->live_fraction = strtod(value, NULL);
+        } else if ((value = option_value(argv[i], "--cycle-density"))) {
+            config->cycle_density = strtod(value, NULL);
+        } else if ((value = option_value(argv[i], "--depth"))) {
+            config->chain_depth = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--roots"))) {
+            config->roots = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--cycles"))) {
+            config->cycles = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--nursery"))) {
+            config->nursery = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--promotion-age"))) {
+            config->promotion_age = (unsigned)strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--seed"))) {
+            config->seed = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "--format"))) {
+            if (strcmp(value, "csv") != 0 && strcmp(value, "json") != 0) {
+                break;
+            }
+            *json = strcmp(value, "json") == 0;
+        } else if ((value = option_value(argv[i], "--dump"))) {
+            config->dump_path = value;
+        } else if ((value = option_value(argv[i], "--events"))) {
+            config->events_path = value;
+        } else if (strcmp(argv[i], "--no-header") == 0) {
+            *header = 0;
+        } else {
+            break;
+        }
+    }
+
+    int valid = i == argc && config->chunks > 0 && config->roots > 0 && config->cycles > 0 &&
+                config->nursery > 0 && config->live_fraction >= 0.0 && config->live_fraction <= 1.0 &&
+                config->cycle_density >= 0.0 && config->cycle_density <= 1.0;
+    if (!valid) {
+        fprintf(stderr,
+                "Usage: %s --bench [--collector=mark-sweep|generational|copying|mark-compact]\n"
+                "       [--shape=random|list|tree|powerlaw] [--fanout-dist=fixed|uniform|powerlaw]\n"
+                "       [--chunks=N] [--fanout=N] [--live=F] [--cycle-density=F] [--depth=N]\n"
+                "       [--roots=N] [--cycles=N] [--nursery=N] [--promotion-age=N] [--seed=N]\n"
+                "       [--format=csv|json] [--no-header] [--dump=FILE] [--events=FILE]\n",
+                argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+/* Header shared with R/gc_timing.R --csv so both logs can be concatenated. */
+#define BURST_CSV_HEADER "runtime,iteration,time_ms,gc_count,gc_ms,heap_bytes"
+
+/*
+ * Mirror of alloc_burst() in R/gc_timing.R: each iteration roots a list of
+ * list_length slots, fills it with fresh chunks of element_slots slots each
+ * (the stand-in for runif(size)), then drops the root. One CSV row per
+ * iteration gives its wall time, the collections that ran inside it and their
+ * total pause. heap_bytes is the occupancy left by the most recent collection,
+ * carried over when an iteration has none, matching what gcinfo reports in R.
+ */
+static void run_burst_workload(CollectorMode collector, size_t iterations, size_t list_length,
+                               size_t element_slots, FILE *out, int header) {
+    ProgramState state = create_program_state(8, 1024);
+    if (collector == COLLECTOR_GENERATIONAL) {
+        enable_generational(&state, 4096, DEFAULT_PROMOTION_AGE);
+    } else if (collector == COLLECTOR_COPYING || collector == COLLECTOR_MARK_COMPACT) {
+        enable_moving(&state, collector, 1 << 20);
+    }
+    if (header) {
+        fprintf(out, "%s\n", BURST_CSV_HEADER);
+    }
+
+    size_t heap_bytes = 0;
+    /* Iteration 0 is the warm-up, as in the R script, and is not reported. */
+    for (size_t iteration = 0; iteration <= iterations; ++iteration) {
+        size_t first_event = state.stats.event_count;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        update_stack(&state, "x", allocate_chunk(&state, "list", list_length));
+        for (size_t i = 0; i < list_length; ++i) {
+            HeapChunk *element = allocate_chunk(&state, "vector", element_slots);
+            /* Allocation may have collected and moved the list. */
+            connect_chunks(&state, find_variable(&state, "x")->ref, i, element);
+        }
+        update_stack(&state, "x", NULL);
+        double seconds = seconds_since(&start);
+
+        size_t gc_count = state.stats.event_count - first_event;
+        double gc_seconds = 0.0;
+        for (size_t e = first_event; e < state.stats.event_count; ++e) {
+            gc_seconds += state.stats.events[e].pause_seconds;
+            heap_bytes = state.stats.events[e].bytes_after;
+        }
+        if (iteration > 0) {
+            fprintf(out, "c-%s,%zu,%.4f,%zu,%.4f,%zu\n", collector_name(collector), iteration, seconds * 1e3,
+                    gc_count, gc_seconds * 1e3, heap_bytes);
+        }
+    }
+    destroy_program_state(&state);
+}
+
+/*
+ * Load a snapshot, collect it once with the chosen collector and optionally
+ * dump the surviving heap and the collection log.
+ */
+static void run_snapshot(const char *path, CollectorMode collector, const char *dump_path,
+                         const char *dump_text_path, const char *events_path) {
+    ProgramState state = create_program_state(16, 1024);
+    if (collector == COLLECTOR_GENERATIONAL) {
+        enable_generational(&state, 4096, DEFAULT_PROMOTION_AGE);
+    } else if (collector == COLLECTOR_COPYING || collector == COLLECTOR_MARK_COMPACT) {
+        enable_moving(&state, collector, 1 << 20);
+    }
+
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    load_snapshot(&state, path);
+    double load_seconds = seconds_since(&start);
+
+    size_t slots = 0;
+    for (size_t i = 0; i < state.heap_size; ++i) {
+        slots += state.heap[i]->reference_capacity;
+    }
+    printf("Loaded %s: %zu chunks, %zu slots, %zu roots, %lld bytes in %.3f ms (%.1f MB/s)\n", path,
+           state.heap_size, slots, state.stack_size, (long long)info.st_size, load_seconds * 1e3,
+           load_seconds > 0.0 ? (double)info.st_size / load_seconds / 1e6 : 0.0);
+
+    puts("\nInitial program state:");
+    print_state(&state);
+
+    run_gc(&state);
+    puts("\nProgram state after GC:");
+    print_state(&state);
+    print_gc_summary(&state);
+
+    if (dump_path) {
+        dump_snapshot(&state, dump_path);
+        printf("Wrote binary snapshot %s\n", dump_path);
+    }
+    if (dump_text_path) {
+        dump_text_snapshot(&state, dump_text_path);
+        printf("Wrote text snapshot %s\n", dump_text_path);
+    }
+    if (events_path) {
+        write_gc_events(&state, events_path);
+    }
+    destroy_program_state(&state);
+}
+
+/* Drive the GC demo: build state, run GC, show before/after. */
+int main(int argc, char **argv) {
+#ifdef SAMPLING_PROFILER
+    argc = prof_consume_options(argc, argv);
+#endif
+    if (argc >= 2 && strcmp(argv[1], "--generational") == 0) {
+        run_generational_demo();
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--compare-generational") == 0) {
+        size_t allocations = argc >= 3 ? strtoul(argv[2], NULL, 10) : 1000000;
+        compare_collectors(allocations > 0 ? allocations : 1000000);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--copying") == 0) {
+        run_moving_demo(COLLECTOR_COPYING);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--compact") == 0) {
+        run_moving_demo(COLLECTOR_MARK_COMPACT);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--compare-moving") == 0) {
+        size_t cycles = argc >= 3 ? strtoul(argv[2], NULL, 10) : 20;
+        compare_moving_collectors(cycles > 0 ? cycles : 20);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        WorkloadConfig config = {
+            COLLECTOR_MARK_SWEEP, SHAPE_RANDOM, FANOUT_UNIFORM,
+            100000, 4, 0.25, 0.1, 16, 64, 10, 4096, DEFAULT_PROMOTION_AGE, 42, NULL, NULL
+        };
+        int json = 0;
+        int header = 1;
+        if (!parse_benchmark_options(argc, argv, &config, &json, &header)) {
+            return EXIT_FAILURE;
+        }
+        run_benchmark(&config, json, header);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--burst") == 0) {
+        CollectorMode collector = COLLECTOR_MARK_SWEEP;
+        size_t iterations = 300;
+        size_t list_length = 20000;
+        size_t element_slots = 100;
+        const char *csv_path = NULL;
+        int header = 1;
+        int i = 2;
+        for (; i < argc; ++i) {
+            const char *value = NULL;
+            if ((value = option_value(argv[i], "--collector"))) {
+                if (!parse_collector(value, &collector)) {
+                    break;
+                }
+            } else if ((value = option_value(argv[i], "--iterations"))) {
+                iterations = strtoul(value, NULL, 10);
+            } else if ((value = option_value(argv[i], "--length"))) {
+                list_length = strtoul(value, NULL, 10);
+            } else if ((value = option_value(argv[i], "--size"))) {
+                element_slots = strtoul(value, NULL, 10);
+            } else if ((value = option_value(argv[i], "--csv"))) {
+                csv_path = value;
+            } else if (strcmp(argv[i], "--no-header") == 0) {
+                header = 0;
+            } else {
+                break;
+            }
+        }
+        if (i != argc || iterations == 0 || list_length == 0) {
+            fprintf(stderr,
+                    "Usage: %s --burst [--collector=mark-sweep|generational|copying|mark-compact]\n"
+                    "       [--iterations=N] [--length=N] [--size=N] [--csv=FILE] [--no-header]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        FILE *out = csv_path ? fopen(csv_path, "w") : stdout;
+        if (!out) {
+            perror(csv_path);
+            return EXIT_FAILURE;
+        }
+        run_burst_workload(collector, iterations, list_length, element_slots, out, header);
+        if (out != stdout && (ferror(out) || fclose(out) != 0)) {
+            fprintf(stderr, "Failed to write '%s'.\n", csv_path);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && option_value(argv[1], "--load")) {
+        CollectorMode collector = COLLECTOR_MARK_SWEEP;
+        const char *dump_path = NULL;
+        const char *dump_text_path = NULL;
+        const char *events_path = NULL;
+        int i = 2;
+        for (; i < argc; ++i) {
+            const char *value = NULL;
+            if ((value = option_value(argv[i], "--collector"))) {
+                if (!parse_collector(value, &collector)) {
+                    break;
+                }
+            } else if ((value = option_value(argv[i], "--dump"))) {
+                dump_path = value;
+            } else if ((value = option_value(argv[i], "--dump-text"))) {
+                dump_text_path = value;
+            } else if ((value = option_value(argv[i], "--events"))) {
+                events_path = value;
+            } else {
+                break;
+            }
+        }
+        if (i != argc) {
+            fprintf(stderr,
+                    "Usage: %s --load=FILE [--collector=mark-sweep|generational|copying|mark-compact]\n"
+                    "       [--dump=FILE] [--dump-text=FILE] [--events=FILE]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        run_snapshot(option_value(argv[1], "--load"), collector, dump_path, dump_text_path, events_path);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--scale") == 0) {
+        size_t roots = argc >= 3 ? strtoul(argv[2], NULL, 10) : 200000;
+        size_t chunks = argc >= 4 ? strtoul(argv[3], NULL, 10) : 2000000;
+        run_scale_test(roots > 0 ? roots : 200000, chunks);
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2) {
+        fprintf(stderr,
+                "Usage: %s [--generational | --copying | --compact |\n"
+                "          --compare-generational [allocations] | --compare-moving [cycles] |\n"
+                "          --scale [roots] [chunks] | --bench [options] | --burst [options] |\n"
+                "          --load=FILE [options]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ProgramState state = create_program_state(8, 16);
+
+    build_demo_state(&state);
+
+    puts("Initial program state:");
+    print_state(&state);
+
+    puts("\nRunning mark-and-sweep garbage collector...");
     run_gc(&state);
 
     puts("\nProgram state after GC:");
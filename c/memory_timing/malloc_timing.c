@@ -1,86 +1,1599 @@
 #define _POSIX_C_SOURCE 200809L
+/* MAP_ANONYMOUS, MAP_POPULATE, MADV_HUGEPAGE and sched_setaffinity are extensions. */
+#define _GNU_SOURCE
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
 
 /**
  * @file malloc_timing.c
  * @author Max Petite
  * @date 2025-11-11
  *
- * Measures average malloc latency across various allocation sizes.
+ * Measures malloc latency across various allocation sizes. Every sample goes
+ * into a log-linear histogram so the tail is reported alongside the mean, and
+ * the cost of reading the clock is calibrated once and subtracted.
+ * glibc malloc is compared against three in-tree allocators behind a common
+ * interface: a bump arena, a fixed-size pool and a size-class slab.
+ * --threads runs the same allocators from 1-64 threads (thread-local,
+ * producer/consumer and bursty patterns) to expose contention and RSS growth.
+ * --faults separates allocation, first-touch and free cost for large buffers
+ * and compares mmap, MAP_POPULATE, transparent huge pages and buffer reuse.
+ * --sweep walks request sizes from 8 B to 1 GiB, and --format=csv|json emits
+ * one row per measurement for plotting.
  */
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef SAMPLING_PROFILER
+#include "../shared/sampling_profiler.h"
+#endif
+
+/*
+ * Histogram layout: values below 2 * SUB_BUCKETS nanoseconds get a bucket
+ * each; above that every power of two is split into SUB_BUCKETS linear
+ * buckets, so any recorded value is within 1/SUB_BUCKETS (about 3%) of exact.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+#define CALIBRATION_SAMPLES 100000
+
+#define ALLOCATION_ALIGNMENT 16
+#define ARENA_BLOCK_BYTES (64u << 20)
+#define POOL_SLAB_BYTES (1u << 20)
+#define POOL_MIN_BLOCKS_PER_SLAB 16
+#define POOL_MAX_SLAB_BYTES (64u << 20)
+#define SLAB_MIN_CLASS_BYTES 16
+#define SLAB_MAX_CLASS_BYTES 32768
+#define SLAB_CLASS_COUNT 12     /* 16 B .. 32 KiB */
+#define MIXED_MIN_BYTES 16
+#define INTERLEAVE_LIVE_OBJECTS 1024
+#define INTERLEAVE_ROUND 16384
+#define MAX_THREADS 64
+#define THREAD_MAX_BYTES 1024       /* threaded requests are 16 B .. 1 KiB */
+#define THREAD_BURST_OBJECTS 1024
+#define HANDOFF_QUEUE_SLOTS 1024
+#define DEFAULT_THREAD_OPERATIONS 100000
+#define HUGE_PAGE_BYTES (2u << 20)
+#define DEFAULT_FAULT_REPETITIONS 10
+#define SWEEP_MIN_BYTES 8
+#define SWEEP_MAX_BYTES ((size_t)1 << 30)
+#define SWEEP_DEFAULT_STEPS 2            /* linear steps per power of two */
+#define SWEEP_DEFAULT_ITERATIONS 10000
+#define SWEEP_MIN_ITERATIONS 5
+#define SWEEP_BYTE_BUDGET ((size_t)256 << 20) /* bytes touched per sweep point */
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+typedef enum ScenarioKind {
+    SCENARIO_FIXED,         /* allocate a batch of one size, then free it */
+    SCENARIO_MIXED,         /* same, with log-uniform sizes up to the maximum */
+    SCENARIO_INTERLEAVED    /* random mix of allocate and free over a live set */
+} ScenarioKind;
 
 typedef struct AllocationScenario {
     const char *label;
-    size_t element_count;
+    size_t bytes;           /* bytes per request, or the maximum for mixed sizes */
     size_t iterations;
+    ScenarioKind kind;
 } AllocationScenario;
 
-/* Convert a timespec to fractional seconds. */
-static double timespec_to_seconds(const struct timespec *ts) {
-    return ts->tv_sec + ts->tv_nsec / 1e9;
+typedef struct LatencyHistogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} LatencyHistogram;
+
+/* Empty a histogram before a new run. */
+static void histogram_reset(LatencyHistogram *histogram) {
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT64_MAX;
 }
 
-/* Average the allocation latency for a specific payload size. */
-static double measure_malloc_time(size_t element_count, size_t iterations) {
-    const size_t bytes = element_count * sizeof(int);
+/* Bucket holding a value in nanoseconds. */
+static size_t histogram_index(uint64_t value) {
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    uint64_t mantissa = value >> shift; /* in [SUB_BUCKETS, 2 * SUB_BUCKETS) */
+    return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS + (size_t)(mantissa - HISTOGRAM_SUB_BUCKETS);
+}
 
-    /* Warm-up allocation to avoid startup cost. */
-    int *warmup = malloc(bytes);
-    if (!warmup) {
-        fprintf(stderr, "Warm-up allocation failed for %zu elements.\n", element_count);
+/* Midpoint of the values that map to a bucket. */
+static double histogram_bucket_value(size_t index) {
+    if (index < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return (double)index;
+    }
+    unsigned shift = (unsigned)(index / HISTOGRAM_SUB_BUCKETS) - 1;
+    uint64_t mantissa = index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    uint64_t low = mantissa << shift;
+    return (double)low + (double)(((uint64_t)1 << shift) - 1) / 2.0;
+}
+
+/* Add one sample in nanoseconds. */
+static void histogram_record(LatencyHistogram *histogram, uint64_t value) {
+    ++histogram->counts[histogram_index(value)];
+    ++histogram->total;
+    histogram->sum += (double)value;
+    if (value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+/* Value at the given fraction of samples, clamped to the exact min and max. */
+static double histogram_percentile(const LatencyHistogram *histogram, double fraction) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)(fraction * (double)histogram->total + 0.999999);
+    rank = rank == 0 ? 1 : (rank > histogram->total ? histogram->total : rank);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            double value = histogram_bucket_value(i);
+            if (value < (double)histogram->min) {
+                return (double)histogram->min;
+            }
+            return value > (double)histogram->max ? (double)histogram->max : value;
+        }
+    }
+    return (double)histogram->max;
+}
+
+/* Nanoseconds from start to end. */
+static int64_t elapsed_ns(const struct timespec *start, const struct timespec *end) {
+    return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+}
+
+/* Median cost of a back-to-back clock_gettime pair, subtracted from every sample. */
+static uint64_t calibrate_timer_overhead(void) {
+    static LatencyHistogram histogram;
+    histogram_reset(&histogram);
+    struct timespec start;
+    struct timespec end;
+    for (size_t i = 0; i < CALIBRATION_SAMPLES; ++i) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        histogram_record(&histogram, (uint64_t)elapsed_ns(&start, &end));
+    }
+    return (uint64_t)histogram_percentile(&histogram, 0.5);
+}
+
+/*
+ * Allocator interface: every benchmark goes through these calls so glibc
+ * malloc and the in-tree allocators are measured the same way. release is
+ * told the size, so the custom allocators keep no per-block header; reset is
+ * NULL unless the allocator can drop everything at once.
+ */
+typedef struct Allocator {
+    const char *name;
+    void *(*allocate)(void *context, size_t bytes);
+    void (*release)(void *context, void *pointer, size_t bytes);
+    void (*reset)(void *context);
+    void (*destroy)(void *context);
+    void *context;
+} Allocator;
+
+typedef enum AllocatorKind {
+    ALLOCATOR_MALLOC,
+    ALLOCATOR_ARENA,
+    ALLOCATOR_POOL,
+    ALLOCATOR_SLAB,
+    ALLOCATOR_KIND_COUNT
+} AllocatorKind;
+
+/* malloc/calloc wrapper that exits on failure, for allocator bookkeeping. */
+static void *checked_malloc(size_t bytes, const char *what) {
+    void *memory = malloc(bytes);
+    if (!memory) {
+        fprintf(stderr, "Failed to allocate %zu bytes for %s.\n", bytes, what);
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+/* Round bytes up to the 16-byte alignment every allocator hands out. */
+static size_t align_size(size_t bytes) {
+    return (bytes + ALLOCATION_ALIGNMENT - 1) & ~(size_t)(ALLOCATION_ALIGNMENT - 1);
+}
+
+static void *malloc_allocate(void *context, size_t bytes) {
+    (void)context;
+    return malloc(bytes);
+}
+
+static void malloc_release(void *context, void *pointer, size_t bytes) {
+    (void)context;
+    (void)bytes;
+    free(pointer);
+}
+
+static void malloc_destroy(void *context) {
+    (void)context;
+}
+
+/*
+ * Bump arena: allocation advances a pointer through large blocks. Freeing the
+ * most recent allocation rolls the pointer back; anything else is reclaimed
+ * only by arena_reset, which rewinds every block for reuse.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    unsigned char *base;    /* first aligned byte */
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+typedef struct ArenaAllocator {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t block_size;
+} ArenaAllocator;
+
+/* New block with room for at least bytes, linked after the current one. */
+static ArenaBlock *arena_add_block(ArenaAllocator *arena, size_t bytes) {
+    size_t size = bytes > arena->block_size ? bytes : arena->block_size;
+    ArenaBlock *block = checked_malloc(sizeof(*block) + size + ALLOCATION_ALIGNMENT, "arena block");
+    uintptr_t start = (uintptr_t)(block + 1);
+    block->base = (unsigned char *)((start + ALLOCATION_ALIGNMENT - 1) & ~(uintptr_t)(ALLOCATION_ALIGNMENT - 1));
+    block->size = size;
+    block->used = 0;
+    if (arena->current) {
+        block->next = arena->current->next;
+        arena->current->next = block;
+    } else {
+        block->next = NULL;
+        arena->first = block;
+    }
+    return block;
+}
+
+static void *arena_allocate(void *context, size_t bytes) {
+    ArenaAllocator *arena = context;
+    bytes = align_size(bytes);
+    ArenaBlock *block = arena->current;
+    while (block && block->size - block->used < bytes) {
+        /* Blocks after current are empty: they were rewound by a reset. */
+        block = block->next;
+    }
+    if (!block) {
+        block = arena_add_block(arena, bytes);
+    }
+    arena->current = block;
+    void *pointer = block->base + block->used;
+    block->used += bytes;
+    return pointer;
+}
+
+static void arena_release(void *context, void *pointer, size_t bytes) {
+    ArenaAllocator *arena = context;
+    ArenaBlock *block = arena->current;
+    if (block && (unsigned char *)pointer + align_size(bytes) == block->base + block->used) {
+        block->used -= align_size(bytes);
+    }
+}
+
+static void arena_reset(void *context) {
+    ArenaAllocator *arena = context;
+    for (ArenaBlock *block = arena->first; block; block = block->next) {
+        block->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+static void arena_destroy(void *context) {
+    ArenaAllocator *arena = context;
+    ArenaBlock *block = arena->first;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+/*
+ * Fixed-size pool: blocks of one size carved from large slabs, with freed
+ * blocks threaded through an intrusive singly linked list. Slabs are carved
+ * lazily so a new slab's pages are not all touched at once.
+ */
+typedef struct PoolAllocator {
+    size_t block_size;
+    size_t blocks_per_slab;
+    void *free_list;
+    unsigned char *carve;       /* next never-used block in the newest slab */
+    size_t carve_remaining;
+    void **slabs;
+    size_t slab_count;
+    size_t slab_capacity;
+} PoolAllocator;
+
+/* Prepare a pool for blocks of up to block_size bytes. */
+static void pool_init(PoolAllocator *pool, size_t block_size) {
+    memset(pool, 0, sizeof(*pool));
+    pool->block_size = align_size(block_size > sizeof(void *) ? block_size : sizeof(void *));
+    pool->blocks_per_slab = POOL_SLAB_BYTES / pool->block_size;
+    if (pool->blocks_per_slab < POOL_MIN_BLOCKS_PER_SLAB) {
+        pool->blocks_per_slab = POOL_MIN_BLOCKS_PER_SLAB;
+    }
+    /* Huge blocks get fewer per slab, so a 1 GiB pool does not reserve 16 GiB up front. */
+    if (pool->block_size * pool->blocks_per_slab > POOL_MAX_SLAB_BYTES) {
+        pool->blocks_per_slab = POOL_MAX_SLAB_BYTES / pool->block_size;
+        if (pool->blocks_per_slab == 0) {
+            pool->blocks_per_slab = 1;
+        }
+    }
+}
+
+/* Start carving blocks from a new slab. */
+static void pool_grow(PoolAllocator *pool) {
+    if (pool->slab_count == pool->slab_capacity) {
+        pool->slab_capacity = pool->slab_capacity ? pool->slab_capacity * 2 : 8;
+        void **slabs = realloc(pool->slabs, pool->slab_capacity * sizeof(*slabs));
+        if (!slabs) {
+            fprintf(stderr, "Failed to grow pool slab list.\n");
+            exit(EXIT_FAILURE);
+        }
+        pool->slabs = slabs;
+    }
+    unsigned char *slab = checked_malloc(pool->block_size * pool->blocks_per_slab, "pool slab");
+    pool->slabs[pool->slab_count++] = slab;
+    pool->carve = slab;
+    pool->carve_remaining = pool->blocks_per_slab;
+}
+
+static void *pool_pop(PoolAllocator *pool) {
+    void *block = pool->free_list;
+    if (block) {
+        pool->free_list = *(void **)block;
+        return block;
+    }
+    if (pool->carve_remaining == 0) {
+        pool_grow(pool);
+    }
+    block = pool->carve;
+    pool->carve += pool->block_size;
+    --pool->carve_remaining;
+    return block;
+}
+
+static void pool_push(PoolAllocator *pool, void *block) {
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+}
+
+static void pool_free_slabs(PoolAllocator *pool) {
+    for (size_t i = 0; i < pool->slab_count; ++i) {
+        free(pool->slabs[i]);
+    }
+    free(pool->slabs);
+}
+
+static void *pool_allocate(void *context, size_t bytes) {
+    PoolAllocator *pool = context;
+    return bytes <= pool->block_size ? pool_pop(pool) : NULL;
+}
+
+static void pool_release(void *context, void *pointer, size_t bytes) {
+    (void)bytes;
+    pool_push(context, pointer);
+}
+
+static void pool_destroy(void *context) {
+    pool_free_slabs(context);
+    free(context);
+}
+
+/*
+ * Size-class slab: one pool per power-of-two class from 16 bytes up to
+ * SLAB_MAX_CLASS_BYTES; larger requests go straight to malloc.
+ */
+typedef struct SlabAllocator {
+    PoolAllocator classes[SLAB_CLASS_COUNT];
+} SlabAllocator;
+
+/* Class index for a request of bytes, or SLAB_CLASS_COUNT if too large. */
+static size_t slab_class(size_t bytes) {
+    if (bytes > SLAB_MAX_CLASS_BYTES) {
+        return SLAB_CLASS_COUNT;
+    }
+    if (bytes <= SLAB_MIN_CLASS_BYTES) {
+        return 0;
+    }
+    /* ceil(log2(bytes)) - log2(SLAB_MIN_CLASS_BYTES) */
+    return (size_t)(64 - __builtin_clzll((unsigned long long)bytes - 1)) - 4;
+}
+
+static void *slab_allocate(void *context, size_t bytes) {
+    SlabAllocator *slab = context;
+    size_t index = slab_class(bytes);
+    return index < SLAB_CLASS_COUNT ? pool_pop(&slab->classes[index]) : malloc(bytes);
+}
+
+static void slab_release(void *context, void *pointer, size_t bytes) {
+    SlabAllocator *slab = context;
+    size_t index = slab_class(bytes);
+    if (index < SLAB_CLASS_COUNT) {
+        pool_push(&slab->classes[index], pointer);
+    } else {
+        free(pointer);
+    }
+}
+
+static void slab_destroy(void *context) {
+    SlabAllocator *slab = context;
+    for (size_t i = 0; i < SLAB_CLASS_COUNT; ++i) {
+        pool_free_slabs(&slab->classes[i]);
+    }
+    free(slab);
+}
+
+static const char *allocator_kind_name(AllocatorKind kind) {
+    switch (kind) {
+    case ALLOCATOR_MALLOC:
+        return "malloc";
+    case ALLOCATOR_ARENA:
+        return "arena";
+    case ALLOCATOR_POOL:
+        return "pool";
+    case ALLOCATOR_SLAB:
+        return "slab";
+    case ALLOCATOR_KIND_COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+/*
+ * Build an allocator of the given kind. max_bytes is the largest request the
+ * workload makes; the pool uses it as its block size.
+ */
+static Allocator create_allocator(AllocatorKind kind, size_t max_bytes) {
+    Allocator allocator = {allocator_kind_name(kind), malloc_allocate, malloc_release, NULL, malloc_destroy, NULL};
+    if (kind == ALLOCATOR_ARENA) {
+        ArenaAllocator *arena = checked_malloc(sizeof(*arena), "arena");
+        arena->first = NULL;
+        arena->current = NULL;
+        arena->block_size = ARENA_BLOCK_BYTES;
+        allocator.allocate = arena_allocate;
+        allocator.release = arena_release;
+        allocator.reset = arena_reset;
+        allocator.destroy = arena_destroy;
+        allocator.context = arena;
+    } else if (kind == ALLOCATOR_POOL) {
+        PoolAllocator *pool = checked_malloc(sizeof(*pool), "pool");
+        pool_init(pool, max_bytes);
+        allocator.allocate = pool_allocate;
+        allocator.release = pool_release;
+        allocator.destroy = pool_destroy;
+        allocator.context = pool;
+    } else if (kind == ALLOCATOR_SLAB) {
+        SlabAllocator *slab = checked_malloc(sizeof(*slab), "slab");
+        for (size_t i = 0; i < SLAB_CLASS_COUNT; ++i) {
+            pool_init(&slab->classes[i], (size_t)SLAB_MIN_CLASS_BYTES << i);
+        }
+        allocator.allocate = slab_allocate;
+        allocator.release = slab_release;
+        allocator.destroy = slab_destroy;
+        allocator.context = slab;
+    }
+    return allocator;
+}
+
+/* xorshift64 step for reproducible request sizes. */
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/* Request size for a scenario: fixed, or log-uniform up to its maximum. */
+static size_t scenario_bytes(const AllocationScenario *scenario, uint64_t *seed) {
+    size_t max_bytes = scenario->bytes;
+    if (scenario->kind == SCENARIO_FIXED || max_bytes <= MIXED_MIN_BYTES) {
+        return max_bytes;
+    }
+    /* Pick a power of two in [MIXED_MIN_BYTES, max_bytes], then a size below the next one. */
+    size_t classes = 0;
+    while (((size_t)MIXED_MIN_BYTES << (classes + 1)) <= max_bytes) {
+        ++classes;
+    }
+    size_t low = (size_t)MIXED_MIN_BYTES << (next_random(seed) % (classes + 1));
+    size_t bytes = low + next_random(seed) % low;
+    return bytes < max_bytes ? bytes : max_bytes;
+}
+
+/* Call allocate, exiting if the allocator is out of memory. */
+static void *allocate_or_exit(Allocator *allocator, size_t bytes) {
+    void *pointer = allocator->allocate(allocator->context, bytes);
+    if (!pointer) {
+        fprintf(stderr, "%s allocation of %zu bytes failed.\n", allocator->name, bytes);
         exit(EXIT_FAILURE);
     }
-    memset(warmup, 0, bytes);
-    free(warmup);
+    return pointer;
+}
+
+/* Time per call of a timed region, with the clock's own cost removed. */
+static uint64_t per_call_ns(const struct timespec *start, const struct timespec *end, uint64_t timer_overhead,
+                            size_t calls) {
+    int64_t elapsed = elapsed_ns(start, end) - (int64_t)timer_overhead;
+    return elapsed > 0 ? (uint64_t)elapsed / calls : 0;
+}
+
+/*
+ * Allocate-then-free rounds. Each sample times batch back-to-back allocate
+ * calls (recording the per-call average, which keeps the clock from
+ * dominating very fast calls), touches the memory untimed, then times
+ * releasing the batch in reverse order.
+ */
+static void measure_batches(const AllocationScenario *scenario, Allocator *allocator, size_t batch,
+                            uint64_t timer_overhead, LatencyHistogram *alloc_latency,
+                            LatencyHistogram *free_latency) {
+    void **buffers = checked_malloc(batch * sizeof(*buffers), "batch pointers");
+    size_t *sizes = checked_malloc(batch * sizeof(*sizes), "batch sizes");
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
 
     struct timespec start = {0, 0};
     struct timespec end = {0, 0};
 
-    double accumulated = 0.0;
+    for (size_t i = 0; i < scenario->iterations; ++i) {
+        for (size_t b = 0; b < batch; ++b) {
+            sizes[b] = scenario_bytes(scenario, &seed);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t b = 0; b < batch; ++b) {
+            buffers[b] = allocator->allocate(allocator->context, sizes[b]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        histogram_record(alloc_latency, per_call_ns(&start, &end, timer_overhead, batch));
+
+        for (size_t b = 0; b < batch; ++b) {
+            if (!buffers[b]) {
+                fprintf(stderr, "%s allocation failed at iteration %zu for %zu bytes.\n", allocator->name, i,
+                        sizes[b]);
+                exit(EXIT_FAILURE);
+            }
+            memset(buffers[b], 0, sizes[b]);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t b = batch; b-- > 0;) {
+            allocator->release(allocator->context, buffers[b], sizes[b]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        histogram_record(free_latency, per_call_ns(&start, &end, timer_overhead, batch));
+
+        if (allocator->reset) {
+            allocator->reset(allocator->context);
+        }
+    }
+    free(sizes);
+    free(buffers);
+}
+
+/*
+ * Interleaved allocate/free: keep up to INTERLEAVE_LIVE_OBJECTS live, and at
+ * each step either allocate (mixed sizes) or free a random live object, timing
+ * every call. Every INTERLEAVE_ROUND steps the remaining objects are freed
+ * and the allocator is reset, which bounds the arena's footprint.
+ */
+static void measure_interleaved(const AllocationScenario *scenario, Allocator *allocator, uint64_t timer_overhead,
+                                uint64_t seed, LatencyHistogram *alloc_latency, LatencyHistogram *free_latency) {
+    void *live[INTERLEAVE_LIVE_OBJECTS];
+    size_t sizes[INTERLEAVE_LIVE_OBJECTS];
+    size_t live_count = 0;
+
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+
+    for (size_t step = 0; step < scenario->iterations; ++step) {
+        uint64_t coin = next_random(&seed);
+        int allocate = live_count < INTERLEAVE_LIVE_OBJECTS / 2 ||
+                       (live_count < INTERLEAVE_LIVE_OBJECTS && (coin & 1));
+        if (allocate) {
+            size_t bytes = scenario_bytes(scenario, &seed);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            void *pointer = allocator->allocate(allocator->context, bytes);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            histogram_record(alloc_latency, per_call_ns(&start, &end, timer_overhead, 1));
+            if (!pointer) {
+                fprintf(stderr, "%s allocation failed at step %zu for %zu bytes.\n", allocator->name, step, bytes);
+                exit(EXIT_FAILURE);
+            }
+            memset(pointer, 0, bytes);
+            live[live_count] = pointer;
+            sizes[live_count++] = bytes;
+        } else {
+            size_t victim = (size_t)((coin >> 1) % live_count);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            allocator->release(allocator->context, live[victim], sizes[victim]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            histogram_record(free_latency, per_call_ns(&start, &end, timer_overhead, 1));
+            live[victim] = live[--live_count];
+            sizes[victim] = sizes[live_count];
+        }
+
+        if ((step + 1) % INTERLEAVE_ROUND == 0 || step + 1 == scenario->iterations) {
+            while (live_count > 0) {
+                --live_count;
+                allocator->release(allocator->context, live[live_count], sizes[live_count]);
+            }
+            if (allocator->reset) {
+                allocator->reset(allocator->context);
+            }
+        }
+    }
+}
+
+/* Run one scenario against a fresh allocator of the given kind. */
+static void measure_scenario(const AllocationScenario *scenario, AllocatorKind kind, size_t batch,
+                             uint64_t timer_overhead, LatencyHistogram *alloc_latency,
+                             LatencyHistogram *free_latency) {
+    size_t max_bytes = scenario->bytes;
+    Allocator allocator = create_allocator(kind, max_bytes);
+
+    /* Warm-up allocation to avoid startup cost. */
+    void *warmup = allocate_or_exit(&allocator, max_bytes);
+    memset(warmup, 0, max_bytes);
+    allocator.release(allocator.context, warmup, max_bytes);
+
+    histogram_reset(alloc_latency);
+    histogram_reset(free_latency);
+    if (scenario->kind == SCENARIO_INTERLEAVED) {
+        measure_interleaved(scenario, &allocator, timer_overhead, 0x2545f4914f6cdd1dULL, alloc_latency,
+                            free_latency);
+    } else {
+        measure_batches(scenario, &allocator, batch, timer_overhead, alloc_latency, free_latency);
+    }
+    allocator.destroy(allocator.context);
+}
+
+typedef enum OutputFormat {
+    OUTPUT_TABLE,
+    OUTPUT_CSV,
+    OUTPUT_JSON
+} OutputFormat;
+
+/*
+ * Every mode reports through one writer, so --format applies to all of them.
+ * The latency, threaded and fault modes each have their own columns.
+ */
+typedef struct ResultWriter {
+    OutputFormat format;
+    uint64_t timer_overhead;
+    size_t batch;
+    size_t rows;
+} ResultWriter;
+
+static int parse_format(const char *value, OutputFormat *format) {
+    if (strcmp(value, "table") == 0) {
+        *format = OUTPUT_TABLE;
+    } else if (strcmp(value, "csv") == 0) {
+        *format = OUTPUT_CSV;
+    } else if (strcmp(value, "json") == 0) {
+        *format = OUTPUT_JSON;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static void begin_results(ResultWriter *writer) {
+    writer->rows = 0;
+    if (writer->format == OUTPUT_CSV) {
+        puts("allocator,scenario,bytes,iterations,repetition,batch,timer_overhead_ns,alloc_mean_ns,alloc_min_ns,"
+             "alloc_p50_ns,alloc_p90_ns,alloc_p99_ns,alloc_p999_ns,alloc_max_ns,free_mean_ns,free_p50_ns,"
+             "free_p99_ns,free_max_ns");
+        return;
+    }
+    if (writer->format == OUTPUT_JSON) {
+        fputs("[", stdout);
+        return;
+    }
+    printf("Latency per call (ns, timer overhead %" PRIu64 " ns subtracted", writer->timer_overhead);
+    if (writer->batch > 1) {
+        printf(", %zu calls per sample outside interleave", writer->batch);
+    }
+    puts("):");
+    puts("Allocator\tScenario\tIterations\tMean\tMin\tp50\tp90\tp99\tp99.9\tMax\tFree mean\tFree p50\tFree p99\tFree max");
+}
+
+/* Emit one measurement; repetition counts from 1. */
+static void write_result(ResultWriter *writer, AllocatorKind kind, const AllocationScenario *scenario,
+                         size_t repetition, const LatencyHistogram *alloc_latency,
+                         const LatencyHistogram *free_latency) {
+    const char *name = allocator_kind_name(kind);
+    size_t iterations = scenario->iterations;
+    /* A short interleave run may never free; report 0 rather than NaN (invalid JSON). */
+    double alloc_mean = alloc_latency->total ? alloc_latency->sum / (double)alloc_latency->total : 0.0;
+    double free_mean = free_latency->total ? free_latency->sum / (double)free_latency->total : 0.0;
+    if (writer->format == OUTPUT_CSV) {
+        printf("%s,%s,%zu,%zu,%zu,%zu,%" PRIu64 ",%.1f,%" PRIu64 ",%.0f,%.0f,%.0f,%.0f,%" PRIu64
+               ",%.1f,%.0f,%.0f,%" PRIu64 "\n",
+               name, scenario->label, scenario->bytes, iterations, repetition, writer->batch, writer->timer_overhead,
+               alloc_mean, alloc_latency->min, histogram_percentile(alloc_latency, 0.50),
+               histogram_percentile(alloc_latency, 0.90), histogram_percentile(alloc_latency, 0.99),
+               histogram_percentile(alloc_latency, 0.999), alloc_latency->max, free_mean,
+               histogram_percentile(free_latency, 0.50), histogram_percentile(free_latency, 0.99), free_latency->max);
+    } else if (writer->format == OUTPUT_JSON) {
+        printf("%s\n  {\"allocator\": \"%s\", \"scenario\": \"%s\", \"bytes\": %zu, \"iterations\": %zu, "
+               "\"repetition\": %zu, \"batch\": %zu, \"timer_overhead_ns\": %" PRIu64 ",\n"
+               "   \"alloc_mean_ns\": %.1f, \"alloc_min_ns\": %" PRIu64 ", \"alloc_p50_ns\": %.0f, "
+               "\"alloc_p90_ns\": %.0f, \"alloc_p99_ns\": %.0f, \"alloc_p999_ns\": %.0f, \"alloc_max_ns\": %" PRIu64
+               ",\n   \"free_mean_ns\": %.1f, \"free_p50_ns\": %.0f, \"free_p99_ns\": %.0f, \"free_max_ns\": %" PRIu64
+               "}",
+               writer->rows > 0 ? "," : "", name, scenario->label, scenario->bytes, iterations, repetition,
+               writer->batch, writer->timer_overhead, alloc_mean, alloc_latency->min,
+               histogram_percentile(alloc_latency, 0.50), histogram_percentile(alloc_latency, 0.90),
+               histogram_percentile(alloc_latency, 0.99), histogram_percentile(alloc_latency, 0.999),
+               alloc_latency->max, free_mean, histogram_percentile(free_latency, 0.50),
+               histogram_percentile(free_latency, 0.99), free_latency->max);
+    } else {
+        printf("%-6s\t%-10s\t%7zu\t%.1f\t%" PRIu64 "\t%.0f\t%.0f\t%.0f\t%.0f\t%" PRIu64
+               "\t%.1f\t%.0f\t%.0f\t%" PRIu64 "\n",
+               name, scenario->label, iterations, alloc_mean, alloc_latency->min,
+               histogram_percentile(alloc_latency, 0.50), histogram_percentile(alloc_latency, 0.90),
+               histogram_percentile(alloc_latency, 0.99), histogram_percentile(alloc_latency, 0.999),
+               alloc_latency->max, free_mean, histogram_percentile(free_latency, 0.50),
+               histogram_percentile(free_latency, 0.99), free_latency->max);
+    }
+    writer->rows++;
+    fflush(stdout);
+}
+
+static void end_results(const ResultWriter *writer) {
+    if (writer->format == OUTPUT_JSON) {
+        puts(writer->rows > 0 ? "\n]" : "]");
+    }
+}
+
+/* Merge src's samples into dst. */
+static void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+typedef enum ThreadPattern {
+    PATTERN_LOCAL,          /* each thread allocates and frees its own objects */
+    PATTERN_PRODUCER_CONSUMER,  /* producers allocate, paired consumers free */
+    PATTERN_BURSTY,         /* bursts of allocations, then free the whole burst */
+    PATTERN_COUNT
+} ThreadPattern;
+
+static const char *pattern_name(ThreadPattern pattern) {
+    switch (pattern) {
+    case PATTERN_LOCAL:
+        return "local";
+    case PATTERN_PRODUCER_CONSUMER:
+        return "prodcons";
+    case PATTERN_BURSTY:
+        return "bursty";
+    case PATTERN_COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+/* Single-producer single-consumer ring used to hand objects across threads. */
+typedef struct HandoffQueue {
+    _Atomic size_t head;    /* next slot the consumer reads */
+    _Atomic size_t tail;    /* next slot the producer writes */
+    void *pointers[HANDOFF_QUEUE_SLOTS];
+    size_t sizes[HANDOFF_QUEUE_SLOTS];
+} HandoffQueue;
+
+static void handoff_push(HandoffQueue *queue, void *pointer, size_t bytes) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == HANDOFF_QUEUE_SLOTS) {
+        sched_yield();
+    }
+    queue->pointers[tail % HANDOFF_QUEUE_SLOTS] = pointer;
+    queue->sizes[tail % HANDOFF_QUEUE_SLOTS] = bytes;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+/* Pop the next object; a NULL pointer means the producer is done. */
+static void *handoff_pop(HandoffQueue *queue, size_t *bytes) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    while (atomic_load_explicit(&queue->tail, memory_order_acquire) == head) {
+        sched_yield();
+    }
+    void *pointer = queue->pointers[head % HANDOFF_QUEUE_SLOTS];
+    *bytes = queue->sizes[head % HANDOFF_QUEUE_SLOTS];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return pointer;
+}
+
+typedef struct ThreadContext {
+    pthread_t thread;
+    ThreadPattern pattern;
+    int producer;           /* producer/consumer role */
+    size_t operations;
+    uint64_t seed;
+    uint64_t timer_overhead;
+    const AllocationScenario *scenario;
+    Allocator allocator;    /* this thread's own instance */
+    HandoffQueue *queue;
+    _Atomic int *start;
+    LatencyHistogram alloc_latency;
+    LatencyHistogram free_latency;
+} ThreadContext;
 
-    for (size_t i = 0; i < iterations; ++i) {
+/* Allocate and free bursts of THREAD_BURST_OBJECTS, timing every call. */
+static void run_bursts(ThreadContext *context) {
+    void *live[THREAD_BURST_OBJECTS];
+    size_t sizes[THREAD_BURST_OBJECTS];
+    Allocator *allocator = &context->allocator;
+    struct timespec start;
+    struct timespec end;
+    for (size_t done = 0; done < context->operations; done += THREAD_BURST_OBJECTS) {
+        size_t count = context->operations - done < THREAD_BURST_OBJECTS ? context->operations - done
+                                                                           : THREAD_BURST_OBJECTS;
+        for (size_t i = 0; i < count; ++i) {
+            sizes[i] = scenario_bytes(context->scenario, &context->seed);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            live[i] = allocator->allocate(allocator->context, sizes[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            histogram_record(&context->alloc_latency, per_call_ns(&start, &end, context->timer_overhead, 1));
+            if (!live[i]) {
+                fprintf(stderr, "%s allocation of %zu bytes failed.\n", allocator->name, sizes[i]);
+                exit(EXIT_FAILURE);
+            }
+            memset(live[i], 0, sizes[i]);
+        }
+        for (size_t i = count; i-- > 0;) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            allocator->release(allocator->context, live[i], sizes[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            histogram_record(&context->free_latency, per_call_ns(&start, &end, context->timer_overhead, 1));
+        }
+        if (allocator->reset) {
+            allocator->reset(allocator->context);
+        }
+    }
+}
+
+/* Producer half of a pair: allocate, touch and hand every object over. */
+static void run_producer(ThreadContext *context) {
+    Allocator *allocator = &context->allocator;
+    struct timespec start;
+    struct timespec end;
+    for (size_t i = 0; i < context->operations; ++i) {
+        size_t bytes = scenario_bytes(context->scenario, &context->seed);
         clock_gettime(CLOCK_MONOTONIC, &start);
-        int *buffer = malloc(bytes);
+        void *pointer = allocator->allocate(allocator->context, bytes);
         clock_gettime(CLOCK_MONOTONIC, &end);
+        histogram_record(&context->alloc_latency, per_call_ns(&start, &end, context->timer_overhead, 1));
+        if (!pointer) {
+            fprintf(stderr, "%s allocation of %zu bytes failed.\n", allocator->name, bytes);
+            exit(EXIT_FAILURE);
+        }
+        memset(pointer, 0, bytes);
+        handoff_push(context->queue, pointer, bytes);
+    }
+    handoff_push(context->queue, NULL, 0);
+}
+
+/* Consumer half of a pair: free every object the producer hands over. */
+static void run_consumer(ThreadContext *context) {
+    Allocator *allocator = &context->allocator;
+    struct timespec start;
+    struct timespec end;
+    size_t bytes = 0;
+    void *pointer;
+    while ((pointer = handoff_pop(context->queue, &bytes)) != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        allocator->release(allocator->context, pointer, bytes);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        histogram_record(&context->free_latency, per_call_ns(&start, &end, context->timer_overhead, 1));
+    }
+}
+
+/* Thread entry: wait for the common start signal, then run the pattern. */
+static void *thread_main(void *argument) {
+    ThreadContext *context = argument;
+    while (!atomic_load_explicit(context->start, memory_order_acquire)) {
+        sched_yield();
+    }
+    if (context->pattern == PATTERN_LOCAL) {
+        AllocationScenario scenario = *context->scenario;
+        scenario.iterations = context->operations;
+        measure_interleaved(&scenario, &context->allocator, context->timer_overhead, context->seed,
+                            &context->alloc_latency, &context->free_latency);
+    } else if (context->pattern == PATTERN_BURSTY) {
+        run_bursts(context);
+    } else if (context->producer) {
+        run_producer(context);
+    } else {
+        run_consumer(context);
+    }
+    return NULL;
+}
+
+/* Current resident set size in KiB (peak RSS where /proc is unavailable). */
+static long resident_kb(void) {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        long size = 0;
+        long resident = 0;
+        int fields = fscanf(statm, "%ld %ld", &size, &resident);
+        fclose(statm);
+        if (fields == 2) {
+            return resident * (sysconf(_SC_PAGESIZE) / 1024);
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void begin_thread_results(ResultWriter *writer, size_t operations) {
+    writer->rows = 0;
+    if (writer->format == OUTPUT_CSV) {
+        puts("pattern,allocator,threads,operations,timer_overhead_ns,mcalls_per_s,alloc_p50_ns,alloc_p99_ns,"
+             "alloc_p999_ns,free_p50_ns,free_p99_ns,worst_thread_p99_ns,rss_growth_kb");
+        return;
+    }
+    if (writer->format == OUTPUT_JSON) {
+        fputs("[", stdout);
+        return;
+    }
+    printf("Threaded allocation (%zu calls per thread, %ld CPUs, ns, timer overhead %" PRIu64 " ns subtracted):\n",
+           operations, sysconf(_SC_NPROCESSORS_ONLN), writer->timer_overhead);
+    puts("Pattern\tAllocator\tThreads\tMcalls/s\tAlloc p50\tAlloc p99\tAlloc p99.9\tFree p50\tFree p99"
+         "\tWorst thread p99\tRSS growth KB");
+}
+
+/* Emit one threaded run; the latencies are merged across all threads. */
+static void write_thread_result(ResultWriter *writer, ThreadPattern pattern, AllocatorKind kind,
+                                size_t thread_count, size_t operations, double mcalls_per_second,
+                                const LatencyHistogram *alloc_latency, const LatencyHistogram *free_latency,
+                                double worst_p99, long rss_growth_kb) {
+    const char *pattern_label = pattern_name(pattern);
+    const char *name = allocator_kind_name(kind);
+    double alloc_p50 = histogram_percentile(alloc_latency, 0.50);
+    double alloc_p99 = histogram_percentile(alloc_latency, 0.99);
+    double alloc_p999 = histogram_percentile(alloc_latency, 0.999);
+    double free_p50 = histogram_percentile(free_latency, 0.50);
+    double free_p99 = histogram_percentile(free_latency, 0.99);
+    if (writer->format == OUTPUT_CSV) {
+        printf("%s,%s,%zu,%zu,%" PRIu64 ",%.2f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%ld\n", pattern_label, name,
+               thread_count, operations, writer->timer_overhead, mcalls_per_second, alloc_p50, alloc_p99,
+               alloc_p999, free_p50, free_p99, worst_p99, rss_growth_kb);
+    } else if (writer->format == OUTPUT_JSON) {
+        printf("%s\n  {\"pattern\": \"%s\", \"allocator\": \"%s\", \"threads\": %zu, \"operations\": %zu, "
+               "\"timer_overhead_ns\": %" PRIu64 ", \"mcalls_per_s\": %.2f,\n"
+               "   \"alloc_p50_ns\": %.0f, \"alloc_p99_ns\": %.0f, \"alloc_p999_ns\": %.0f, \"free_p50_ns\": %.0f, "
+               "\"free_p99_ns\": %.0f, \"worst_thread_p99_ns\": %.0f, \"rss_growth_kb\": %ld}",
+               writer->rows > 0 ? "," : "", pattern_label, name, thread_count, operations, writer->timer_overhead,
+               mcalls_per_second, alloc_p50, alloc_p99, alloc_p999, free_p50, free_p99, worst_p99, rss_growth_kb);
+    } else {
+        printf("%-8s\t%-6s\t%3zu\t%8.2f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%ld\n", pattern_label, name,
+               thread_count, mcalls_per_second, alloc_p50, alloc_p99, alloc_p999, free_p50, free_p99, worst_p99,
+               rss_growth_kb);
+    }
+    writer->rows++;
+    fflush(stdout);
+}
+
+/*
+ * Run one pattern with thread_count threads, each holding its own instance
+ * of the allocator (glibc malloc is shared internally). Frees in the
+ * producer/consumer pattern go to the consumer's instance, so memory drifts
+ * from producer to consumer exactly as it would with per-thread caches.
+ */
+static void run_threaded(ResultWriter *writer, ThreadPattern pattern, AllocatorKind kind, size_t thread_count,
+                         size_t operations, int per_thread) {
+    static const AllocationScenario scenario = {"threaded", THREAD_MAX_BYTES, 0, SCENARIO_MIXED};
+    if (pattern == PATTERN_PRODUCER_CONSUMER && thread_count < 2) {
+        return;
+    }
+    ThreadContext *contexts = checked_malloc(thread_count * sizeof(*contexts), "thread contexts");
+    size_t pairs = thread_count / 2;
+    HandoffQueue *queues = NULL;
+    if (pattern == PATTERN_PRODUCER_CONSUMER) {
+        queues = checked_malloc(pairs * sizeof(*queues), "handoff queues");
+        for (size_t i = 0; i < pairs; ++i) {
+            atomic_init(&queues[i].head, 0);
+            atomic_init(&queues[i].tail, 0);
+        }
+    }
+    _Atomic int start_flag;
+    atomic_init(&start_flag, 0);
+
+    long rss_before = resident_kb();
+    for (size_t t = 0; t < thread_count; ++t) {
+        ThreadContext *context = &contexts[t];
+        context->pattern = pattern;
+        context->producer = pattern == PATTERN_PRODUCER_CONSUMER && t < pairs;
+        context->operations = operations;
+        context->seed = 0x9e3779b97f4a7c15ULL * (t + 1);
+        context->timer_overhead = writer->timer_overhead;
+        context->scenario = &scenario;
+        context->allocator = create_allocator(kind, THREAD_MAX_BYTES);
+        context->queue = queues ? &queues[t < pairs ? t : t - pairs] : NULL;
+        context->start = &start_flag;
+        histogram_reset(&context->alloc_latency);
+        histogram_reset(&context->free_latency);
+    }
+    /* An odd thread out in producer/consumer mode has no partner and sits idle. */
+    size_t active = pattern == PATTERN_PRODUCER_CONSUMER ? 2 * pairs : thread_count;
+    for (size_t t = 0; t < active; ++t) {
+        if (pthread_create(&contexts[t].thread, NULL, thread_main, &contexts[t]) != 0) {
+            fprintf(stderr, "Failed to start thread %zu.\n", t);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    atomic_store_explicit(&start_flag, 1, memory_order_release);
+    for (size_t t = 0; t < active; ++t) {
+        pthread_join(contexts[t].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long rss_after = resident_kb();
+
+    static LatencyHistogram alloc_latency;
+    static LatencyHistogram free_latency;
+    histogram_reset(&alloc_latency);
+    histogram_reset(&free_latency);
+    double worst_p99 = 0.0;
+    for (size_t t = 0; t < active; ++t) {
+        histogram_merge(&alloc_latency, &contexts[t].alloc_latency);
+        histogram_merge(&free_latency, &contexts[t].free_latency);
+        double p99 = histogram_percentile(&contexts[t].alloc_latency, 0.99);
+        worst_p99 = p99 > worst_p99 ? p99 : worst_p99;
+    }
+    double seconds = elapsed_ns(&start, &end) / 1e9;
+    uint64_t calls = alloc_latency.total + free_latency.total;
+    write_thread_result(writer, pattern, kind, thread_count, operations, calls / seconds / 1e6, &alloc_latency,
+                        &free_latency, worst_p99, rss_after - rss_before);
+    if (per_thread) {
+        for (size_t t = 0; t < active; ++t) {
+            const ThreadContext *context = &contexts[t];
+            const LatencyHistogram *latency = context->alloc_latency.total ? &context->alloc_latency
+                                                                           : &context->free_latency;
+            printf("  thread %zu %s: p50 %.0f p99 %.0f p99.9 %.0f max %" PRIu64 "\n", t,
+                   context->alloc_latency.total ? "alloc" : "free", histogram_percentile(latency, 0.50),
+                   histogram_percentile(latency, 0.99), histogram_percentile(latency, 0.999), latency->max);
+        }
+    }
+
+    for (size_t t = 0; t < thread_count; ++t) {
+        contexts[t].allocator.destroy(contexts[t].allocator.context);
+    }
+    free(queues);
+    free(contexts);
+}
+
+/* Parse a comma-separated thread-count list into counts; returns how many. */
+static size_t parse_thread_counts(const char *list, size_t *counts, size_t capacity) {
+    size_t count = 0;
+    while (*list && count < capacity) {
+        char *end = NULL;
+        unsigned long value = strtoul(list, &end, 10);
+        if (end == list || value == 0 || value > MAX_THREADS) {
+            return 0;
+        }
+        counts[count++] = value;
+        list = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return 0;
+        }
+    }
+    return count;
+}
+
+/*
+ * Fill sizes with a log-linear walk from min_bytes to max_bytes: every power
+ * of two is split into steps linear steps (steps = 1 gives powers of two),
+ * the same shape as the latency histogram. Returns the number of sizes.
+ */
+static size_t sweep_sizes(size_t min_bytes, size_t max_bytes, size_t steps, size_t *sizes, size_t capacity) {
+    size_t count = 0;
+    for (size_t base = 1; base <= max_bytes && count < capacity; base <<= 1) {
+        size_t increment = base / steps > 0 ? base / steps : 1;
+        for (size_t bytes = base; bytes < base * 2 && count < capacity; bytes += increment) {
+            if (bytes >= min_bytes && bytes <= max_bytes) {
+                sizes[count++] = bytes;
+            }
+        }
+        if (base > SIZE_MAX / 2) {
+            break;
+        }
+    }
+    return count;
+}
+
+/*
+ * Iterations for one sweep point: the requested count, cut so that one
+ * repetition touches at most SWEEP_BYTE_BUDGET bytes (a 1 GiB point would
+ * otherwise run for hours), but never fewer than SWEEP_MIN_ITERATIONS.
+ */
+static size_t sweep_iterations(size_t bytes, size_t batch, size_t iterations) {
+    size_t budget = SWEEP_BYTE_BUDGET / (bytes * batch);
+    if (budget < SWEEP_MIN_ITERATIONS) {
+        budget = SWEEP_MIN_ITERATIONS;
+    }
+    return iterations < budget ? iterations : budget;
+}
+
+/* Parse "MIN,MAX" for --sweep=. */
+static int parse_sweep_range(const char *text, size_t *min_bytes, size_t *max_bytes) {
+    char *end = NULL;
+    unsigned long long low = strtoull(text, &end, 10);
+    if (end == text || *end != ',') {
+        return 0;
+    }
+    const char *second = end + 1;
+    unsigned long long high = strtoull(second, &end, 10);
+    if (end == second || *end != '\0' || low == 0 || high < low) {
+        return 0;
+    }
+    *min_bytes = (size_t)low;
+    *max_bytes = (size_t)high;
+    return 1;
+}
+
+/* Pin the process to one CPU so migrations do not show up in the tail. */
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Could not pin to CPU %d.\n", cpu);
+        exit(EXIT_FAILURE);
+    }
+#else
+    fprintf(stderr, "--cpu=%d ignored: CPU pinning needs sched_setaffinity (Linux).\n", cpu);
+#endif
+}
+
+typedef enum FaultStrategy {
+    FAULT_MALLOC,           /* glibc malloc, touched after allocation */
+    FAULT_MMAP,             /* anonymous mmap, faulted in on first touch */
+    FAULT_MMAP_POPULATE,    /* MAP_POPULATE: faults taken inside mmap */
+    FAULT_MMAP_HUGEPAGE,    /* madvise(MADV_HUGEPAGE) on a 2 MiB aligned mapping */
+    FAULT_PREFAULTED,       /* one mapping touched up front and reused */
+    FAULT_STRATEGY_COUNT
+} FaultStrategy;
+
+static const char *fault_strategy_name(FaultStrategy strategy) {
+    switch (strategy) {
+    case FAULT_MALLOC:
+        return "malloc";
+    case FAULT_MMAP:
+        return "mmap";
+    case FAULT_MMAP_POPULATE:
+        return "populate";
+    case FAULT_MMAP_HUGEPAGE:
+        return "hugepage";
+    case FAULT_PREFAULTED:
+        return "reuse";
+    case FAULT_STRATEGY_COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+/* Time and page-fault counts for one phase of a fault measurement. */
+typedef struct PhaseCost {
+    double seconds;
+    long minor_faults;
+    long major_faults;
+} PhaseCost;
+
+typedef struct PhaseTimer {
+    struct timespec start;
+    struct rusage usage;
+} PhaseTimer;
+
+static void phase_begin(PhaseTimer *timer) {
+    getrusage(RUSAGE_SELF, &timer->usage);
+    clock_gettime(CLOCK_MONOTONIC, &timer->start);
+}
 
-        if (!buffer) {
-            fprintf(stderr, "Allocation failed at iteration %zu for %zu elements.\n", i, element_count);
+/* Add the time and faults since phase_begin to cost. */
+static void phase_end(const PhaseTimer *timer, PhaseCost *cost) {
+    struct timespec end;
+    struct rusage usage;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &usage);
+    cost->seconds += elapsed_ns(&timer->start, &end) / 1e9;
+    cost->minor_faults += usage.ru_minflt - timer->usage.ru_minflt;
+    cost->major_faults += usage.ru_majflt - timer->usage.ru_majflt;
+}
+
+/* Anonymous private mapping, or NULL. Hugepage mappings are 2 MiB aligned. */
+static void *map_region(FaultStrategy strategy, size_t bytes, void **mapping, size_t *mapping_bytes) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    if (strategy == FAULT_MMAP_POPULATE) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    size_t padding = strategy == FAULT_MMAP_HUGEPAGE ? HUGE_PAGE_BYTES : 0;
+    unsigned char *base = mmap(NULL, bytes + padding, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    *mapping = base;
+    *mapping_bytes = bytes + padding;
+    unsigned char *region = base;
+    if (padding) {
+        region = (unsigned char *)(((uintptr_t)base + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1));
+#ifdef MADV_HUGEPAGE
+        madvise(region, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    return region;
+}
+
+/* Write one byte per page: the first-touch cost. */
+static void touch_pages(unsigned char *region, size_t bytes, size_t page_bytes) {
+    for (size_t offset = 0; offset < bytes; offset += page_bytes) {
+        region[offset] = (unsigned char)offset;
+    }
+    region[bytes - 1] = 1;
+}
+
+/*
+ * Allocate, first-touch and free a bytes-sized buffer repetitions times with
+ * one strategy, accumulating the cost of each phase separately. Returns 0 if
+ * the strategy is unavailable on this system.
+ */
+static int measure_faults(FaultStrategy strategy, size_t bytes, size_t repetitions, PhaseCost *allocate,
+                          PhaseCost *touch, PhaseCost *release) {
+#ifndef MAP_POPULATE
+    if (strategy == FAULT_MMAP_POPULATE) {
+        return 0;
+    }
+#endif
+#ifndef MADV_HUGEPAGE
+    if (strategy == FAULT_MMAP_HUGEPAGE) {
+        return 0;
+    }
+#endif
+    size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+    memset(allocate, 0, sizeof(*allocate));
+    memset(touch, 0, sizeof(*touch));
+    memset(release, 0, sizeof(*release));
+
+    void *reused_mapping = NULL;
+    size_t reused_bytes = 0;
+    unsigned char *reused = NULL;
+    if (strategy == FAULT_PREFAULTED) {
+        reused = map_region(FAULT_MMAP, bytes, &reused_mapping, &reused_bytes);
+        if (!reused) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        touch_pages(reused, bytes, page_bytes);
+    }
+
+    PhaseTimer timer;
+    for (size_t r = 0; r < repetitions; ++r) {
+        void *mapping = NULL;
+        size_t mapping_bytes = 0;
+        unsigned char *region = NULL;
+
+        phase_begin(&timer);
+        if (strategy == FAULT_MALLOC) {
+            region = malloc(bytes);
+        } else if (strategy == FAULT_PREFAULTED) {
+            region = reused;
+        } else {
+            region = map_region(strategy, bytes, &mapping, &mapping_bytes);
+        }
+        phase_end(&timer, allocate);
+        if (!region) {
+            fprintf(stderr, "%s allocation of %zu bytes failed.\n", fault_strategy_name(strategy), bytes);
             exit(EXIT_FAILURE);
         }
 
-        accumulated += timespec_to_seconds(&end) - timespec_to_seconds(&start);
-        memset(buffer, 0, bytes);
-        free(buffer);
+        phase_begin(&timer);
+        touch_pages(region, bytes, page_bytes);
+        phase_end(&timer, touch);
+
+        phase_begin(&timer);
+        if (strategy == FAULT_MALLOC) {
+            free(region);
+        } else if (strategy != FAULT_PREFAULTED) {
+            munmap(mapping, mapping_bytes);
+        }
+        phase_end(&timer, release);
+    }
+
+    if (reused_mapping) {
+        munmap(reused_mapping, reused_bytes);
     }
+    return 1;
+}
 
-    return accumulated / iterations;
+static void begin_fault_results(ResultWriter *writer, size_t repetitions) {
+    writer->rows = 0;
+    if (writer->format == OUTPUT_CSV) {
+        puts("strategy,bytes,repetitions,alloc_us,touch_us,free_us,touch_ns_per_page,alloc_faults,touch_faults,"
+             "free_faults,major_faults");
+        return;
+    }
+    if (writer->format == OUTPUT_JSON) {
+        fputs("[", stdout);
+        return;
+    }
+    printf("Allocation, first-touch and free cost per buffer (us, mean of %zu repetitions; faults per buffer):\n",
+           repetitions);
+    puts("Strategy\tBytes\tAlloc us\tTouch us\tFree us\tTouch ns/page\tAlloc faults\tTouch faults\tFree faults"
+         "\tMajor faults");
+}
+
+/* Emit one strategy's per-buffer means; available is 0 if it cannot run here. */
+static void write_fault_result(ResultWriter *writer, FaultStrategy strategy, size_t bytes, size_t repetitions,
+                               int available, const PhaseCost *allocate, const PhaseCost *touch,
+                               const PhaseCost *release) {
+    const char *name = fault_strategy_name(strategy);
+    if (!available) {
+        /* Machine-readable output has no row for a strategy that never ran. */
+        if (writer->format == OUTPUT_TABLE) {
+            printf("%-8s\t%zu\tunavailable on this system\n", name, bytes);
+        }
+        return;
+    }
+    size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = (bytes + page_bytes - 1) / page_bytes;
+    double n = (double)repetitions;
+    double alloc_us = allocate->seconds / n * 1e6;
+    double touch_us = touch->seconds / n * 1e6;
+    double free_us = release->seconds / n * 1e6;
+    double touch_ns_per_page = touch->seconds / n / (double)pages * 1e9;
+    double major_faults = (allocate->major_faults + touch->major_faults + release->major_faults) / n;
+    if (writer->format == OUTPUT_CSV) {
+        printf("%s,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.0f,%.0f,%.0f,%.0f\n", name, bytes, repetitions, alloc_us, touch_us,
+               free_us, touch_ns_per_page, allocate->minor_faults / n, touch->minor_faults / n,
+               release->minor_faults / n, major_faults);
+    } else if (writer->format == OUTPUT_JSON) {
+        printf("%s\n  {\"strategy\": \"%s\", \"bytes\": %zu, \"repetitions\": %zu, \"alloc_us\": %.1f, "
+               "\"touch_us\": %.1f, \"free_us\": %.1f, \"touch_ns_per_page\": %.1f,\n"
+               "   \"alloc_faults\": %.0f, \"touch_faults\": %.0f, \"free_faults\": %.0f, \"major_faults\": %.0f}",
+               writer->rows > 0 ? "," : "", name, bytes, repetitions, alloc_us, touch_us, free_us,
+               touch_ns_per_page, allocate->minor_faults / n, touch->minor_faults / n, release->minor_faults / n,
+               major_faults);
+    } else {
+        printf("%-8s\t%zu\t%.1f\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%.0f\t%.0f\n", name, bytes, alloc_us, touch_us,
+               free_us, touch_ns_per_page, allocate->minor_faults / n, touch->minor_faults / n,
+               release->minor_faults / n, major_faults);
+    }
+    writer->rows++;
+    fflush(stdout);
 }
 
-/* Iterate through the scenarios and print the timing table. */
-int main(void) {
+/* Report the allocation / first-touch / free breakdown for every strategy. */
+static void run_fault_benchmark(ResultWriter *writer, const size_t *sizes, size_t size_count, size_t repetitions) {
+    begin_fault_results(writer, repetitions);
+    for (size_t s = 0; s < size_count; ++s) {
+        for (int strategy = 0; strategy < FAULT_STRATEGY_COUNT; ++strategy) {
+            PhaseCost allocate;
+            PhaseCost touch;
+            PhaseCost release;
+            int available = measure_faults((FaultStrategy)strategy, sizes[s], repetitions, &allocate, &touch,
+                                           &release);
+            write_fault_result(writer, (FaultStrategy)strategy, sizes[s], repetitions, available, &allocate, &touch,
+                               &release);
+        }
+    }
+    end_results(writer);
+}
+
+/* Iterate through the allocators and scenarios and print the latency table. */
+int main(int argc, char **argv) {
+#ifdef SAMPLING_PROFILER
+    argc = prof_consume_options(argc, argv);
+#endif
+    size_t batch = 1;
+    int selected[ALLOCATOR_KIND_COUNT] = {0};
+    int any_selected = 0;
+    size_t thread_counts[MAX_THREADS] = {1, 2, 4, 8, 16, 32, 64};
+    size_t thread_count_total = 0;
+    size_t operations = DEFAULT_THREAD_OPERATIONS;
+    int per_thread = 0;
+    int faults = 0;
+    size_t fault_sizes[] = {4u << 20, 64u << 20, 256u << 20};
+    size_t fault_size_count = sizeof(fault_sizes) / sizeof(fault_sizes[0]);
+    size_t repetitions = 0;
+    size_t iterations = 0;
+    int sweep = 0;
+    size_t sweep_min = SWEEP_MIN_BYTES;
+    size_t sweep_max = SWEEP_MAX_BYTES;
+    size_t steps = SWEEP_DEFAULT_STEPS;
+    ResultWriter writer = {OUTPUT_TABLE, 0, 1, 0};
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--batch=", 8) == 0 && (batch = strtoul(argv[i] + 8, NULL, 10)) > 0) {
+            continue;
+        }
+        if (strcmp(argv[i], "--threads") == 0) {
+            thread_count_total = 7;
+            continue;
+        }
+        if (strncmp(argv[i], "--threads=", 10) == 0 &&
+            (thread_count_total = parse_thread_counts(argv[i] + 10, thread_counts, MAX_THREADS)) > 0) {
+            continue;
+        }
+        if (strncmp(argv[i], "--ops=", 6) == 0 && (operations = strtoul(argv[i] + 6, NULL, 10)) > 0) {
+            continue;
+        }
+        if (strcmp(argv[i], "--per-thread") == 0) {
+            per_thread = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--faults") == 0) {
+            faults = 1;
+            continue;
+        }
+        if (strncmp(argv[i], "--fault-bytes=", 14) == 0 && (fault_sizes[0] = strtoul(argv[i] + 14, NULL, 10)) > 0) {
+            faults = 1;
+            fault_size_count = 1;
+            continue;
+        }
+        if (strncmp(argv[i], "--repetitions=", 14) == 0 && (repetitions = strtoul(argv[i] + 14, NULL, 10)) > 0) {
+            continue;
+        }
+        if (strncmp(argv[i], "--iterations=", 13) == 0 && (iterations = strtoul(argv[i] + 13, NULL, 10)) > 0) {
+            continue;
+        }
+        if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = 1;
+            continue;
+        }
+        if (strncmp(argv[i], "--sweep=", 8) == 0 && parse_sweep_range(argv[i] + 8, &sweep_min, &sweep_max)) {
+            sweep = 1;
+            continue;
+        }
+        if (strncmp(argv[i], "--steps=", 8) == 0 && (steps = strtoul(argv[i] + 8, NULL, 10)) > 0) {
+            continue;
+        }
+        if (strncmp(argv[i], "--format=", 9) == 0 && parse_format(argv[i] + 9, &writer.format)) {
+            continue;
+        }
+        if (strncmp(argv[i], "--cpu=", 6) == 0 && argv[i][6] >= '0' && argv[i][6] <= '9') {
+            pin_to_cpu(atoi(argv[i] + 6));
+            continue;
+        }
+        if (strncmp(argv[i], "--allocator=", 12) == 0) {
+            int found = 0;
+            for (int kind = 0; kind < ALLOCATOR_KIND_COUNT; ++kind) {
+                if (strcmp(argv[i] + 12, allocator_kind_name((AllocatorKind)kind)) == 0) {
+                    selected[kind] = 1;
+                    any_selected = 1;
+                    found = 1;
+                }
+            }
+            if (found) {
+                continue;
+            }
+        }
+        fprintf(stderr,
+                "Usage: %s [--batch=K] [--allocator=malloc|arena|pool|slab ...]\n"
+                "       [--threads[=N,N,...] [--ops=N] [--per-thread]]\n"
+                "       [--faults [--fault-bytes=N]] [--sweep[=MIN,MAX] [--steps=N]]\n"
+                "       [--iterations=N] [--repetitions=N] [--format=table|csv|json] [--cpu=N]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (faults) {
+        run_fault_benchmark(&writer, fault_sizes, fault_size_count,
+                            repetitions > 0 ? repetitions : DEFAULT_FAULT_REPETITIONS);
+        return EXIT_SUCCESS;
+    }
+    if (thread_count_total > 0) {
+        if (per_thread && writer.format != OUTPUT_TABLE) {
+            fprintf(stderr, "--per-thread is only available with --format=table.\n");
+            return EXIT_FAILURE;
+        }
+        writer.timer_overhead = calibrate_timer_overhead();
+        begin_thread_results(&writer, operations);
+        for (int pattern = 0; pattern < PATTERN_COUNT; ++pattern) {
+            for (int kind = 0; kind < ALLOCATOR_KIND_COUNT; ++kind) {
+                if (any_selected && !selected[kind]) {
+                    continue;
+                }
+                for (size_t i = 0; i < thread_count_total; ++i) {
+                    run_threaded(&writer, (ThreadPattern)pattern, (AllocatorKind)kind, thread_counts[i],
+                                 operations, per_thread);
+                }
+            }
+        }
+        end_results(&writer);
+        return EXIT_SUCCESS;
+    }
+
     const AllocationScenario scenarios[] = {
-        {"100 ints", 100, 50000},
-        {"10K ints", 10000, 10000},
-        {"1M ints", 1000000, 500}
+        {"100 ints", 100 * sizeof(int), 50000, SCENARIO_FIXED},
+        {"10K ints", 10000 * sizeof(int), 10000, SCENARIO_FIXED},
+        {"1M ints", 1000000 * sizeof(int), 500, SCENARIO_FIXED},
+        {"mixed", 4096 * sizeof(int), 50000, SCENARIO_MIXED},
+        {"interleave", 4096 * sizeof(int), 200000, SCENARIO_INTERLEAVED}
     };
 
     const size_t scenario_count = sizeof(scenarios) / sizeof(scenarios[0]);
+    static LatencyHistogram alloc_latency;
+    static LatencyHistogram free_latency;
+    size_t sizes[64 * 64];
+    size_t size_count = sweep ? sweep_sizes(sweep_min, sweep_max, steps, sizes, sizeof(sizes) / sizeof(sizes[0])) : 0;
+    if (repetitions == 0) {
+        repetitions = 1;
+    }
 
-    puts("Average allocation time per malloc call:");
-    puts("Scenario\tIterations\tAverage seconds");
-
-    for (size_t i = 0; i < scenario_count; ++i) {
-        double average = measure_malloc_time(scenarios[i].element_count, scenarios[i].iterations);
-        printf("%-8s\t%7zu\t%.9f\n",
-               scenarios[i].label,
-               scenarios[i].iterations,
-               average);
+    writer.timer_overhead = calibrate_timer_overhead();
+    writer.batch = batch;
+    begin_results(&writer);
+    for (int kind = 0; kind < ALLOCATOR_KIND_COUNT; ++kind) {
+        if (any_selected && !selected[kind]) {
+            continue;
+        }
+        for (size_t i = 0; i < (sweep ? size_count : scenario_count); ++i) {
+            char label[32];
+            AllocationScenario scenario;
+            if (sweep) {
+                /* The table has no bytes column, so the size stands in for the scenario name there. */
+                snprintf(label, sizeof(label), "%zu", sizes[i]);
+                scenario.label = writer.format == OUTPUT_TABLE ? label : "sweep";
+                scenario.bytes = sizes[i];
+                scenario.iterations = sweep_iterations(sizes[i], batch,
+                                                       iterations > 0 ? iterations : SWEEP_DEFAULT_ITERATIONS);
+                scenario.kind = SCENARIO_FIXED;
+            } else {
+                scenario = scenarios[i];
+                if (iterations > 0) {
+                    scenario.iterations = iterations;
+                }
+            }
+            for (size_t r = 0; r < repetitions; ++r) {
+                measure_scenario(&scenario, (AllocatorKind)kind, batch, writer.timer_overhead, &alloc_latency,
+                                 &free_latency);
+                write_result(&writer, (AllocatorKind)kind, &scenario, r + 1, &alloc_latency, &free_latency);
+            }
+        }
     }
+    end_results(&writer);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,314 @@
+#define _POSIX_C_SOURCE 200809L
+/* MAP_ANONYMOUS and MAP_NORESERVE are extensions. */
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+/**
+ * @file guard_arena.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Implements the reserve-then-commit arena. The reservation is one PROT_NONE
+ * mapping followed by a permanent guard page. The SA_SIGINFO handler looks
+ * the faulting address up in a fixed table of live arenas: inside the
+ * uncommitted part of one it mprotects the next batch read/write and returns
+ * so the access restarts; anywhere else it reports the address and hands the
+ * signal to the previous handler, or dies with the default action.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "guard_arena.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+#define GA_ALIGNMENT 16
+#define GA_WORD_BITS (sizeof(unsigned long) * 8)
+
+struct GuardArena {
+    unsigned char *base;
+    size_t reserved;                /* usable bytes; one guard page follows */
+    size_t page_bytes;
+    size_t used;
+    size_t initial_batch;
+    size_t max_batch;
+    _Atomic size_t frontier;        /* [base, base + frontier) is read/write */
+    _Atomic size_t high_water;      /* end of the furthest commit, for ga_reset */
+    _Atomic size_t committed;       /* bytes made read/write by the handler */
+    _Atomic unsigned long *pages;   /* one bit per committed page, so no page is counted twice */
+    size_t pages_bytes;
+    _Atomic size_t batch;
+    _Atomic size_t commit_faults;
+};
+
+/* Written by ga_create/ga_destroy, read by the handler; atomics keep that signal-safe. */
+static GuardArena *_Atomic arenas[GA_MAX_ARENAS];
+static struct sigaction previous_segv;
+static struct sigaction previous_bus;
+static int handler_installed = 0;
+
+static size_t round_up(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+/* write(2) a string; the handler cannot use stdio. */
+static void write_string(const char *text) {
+    (void)write(STDERR_FILENO, text, strlen(text));
+}
+
+/* write(2) an address in hex without stdio. */
+static void write_address(uintptr_t address) {
+    char buffer[2 + sizeof(address) * 2];
+    buffer[0] = '0';
+    buffer[1] = 'x';
+    for (size_t i = 0; i < sizeof(address) * 2; ++i) {
+        unsigned digit = (unsigned)(address >> ((sizeof(address) * 2 - 1 - i) * 4)) & 0xf;
+        buffer[2 + i] = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    }
+    (void)write(STDERR_FILENO, buffer, sizeof(buffer));
+}
+
+/* Move an atomic high-water mark forward to at least value. */
+static void advance_to(_Atomic size_t *mark, size_t value) {
+    size_t current = atomic_load(mark);
+    while (current < value && !atomic_compare_exchange_weak(mark, &current, value)) {
+    }
+}
+
+/* Mark [start, end) committed and return how many of those bytes were not already. */
+static size_t mark_committed(GuardArena *arena, size_t start, size_t end) {
+    size_t added = 0;
+    for (size_t page = start / arena->page_bytes; page < end / arena->page_bytes; ++page) {
+        unsigned long bit = 1UL << (page % GA_WORD_BITS);
+        if (!(atomic_fetch_or(&arena->pages[page / GA_WORD_BITS], bit) & bit)) {
+            added += arena->page_bytes;
+        }
+    }
+    return added;
+}
+
+/*
+ * Commit pages so the access at offset can be retried; returns 0 if
+ * mprotect fails. A fault within one batch of the frontier is sequential
+ * growth, even if a write skipped a few pages: commit from the frontier to
+ * one batch past it and double the batch. A fault further out is a random
+ * access into the reservation: commit that page alone, so sparse tables
+ * stay sparse. Another thread committing the same page first is harmless,
+ * since mprotect on a writable page changes nothing, and the page bitmap
+ * counts it once.
+ */
+static int commit_at(GuardArena *arena, size_t offset) {
+    size_t page = offset / arena->page_bytes * arena->page_bytes;
+    size_t frontier = atomic_load(&arena->frontier);
+    if (page < frontier) {
+        return 1;
+    }
+    size_t batch = atomic_load(&arena->batch);
+    int sequential = page - frontier < batch;
+    size_t start = sequential ? frontier : page;
+    size_t end = sequential ? frontier + batch : page + arena->page_bytes;
+    if (end > arena->reserved) {
+        end = arena->reserved;
+    }
+    if (mprotect(arena->base + start, end - start, PROT_READ | PROT_WRITE) != 0) {
+        return 0;
+    }
+    if (sequential) {
+        advance_to(&arena->frontier, end);
+        atomic_store(&arena->batch, batch * 2 < arena->max_batch ? batch * 2 : arena->max_batch);
+    }
+    advance_to(&arena->high_water, end);
+    atomic_fetch_add(&arena->committed, mark_committed(arena, start, end));
+    atomic_fetch_add(&arena->commit_faults, 1);
+    return 1;
+}
+
+/* Restore the previous disposition for sig and deliver it there. */
+static void forward_signal(int sig, siginfo_t *info, void *context) {
+    struct sigaction *previous = sig == SIGSEGV ? &previous_segv : &previous_bus;
+    if ((previous->sa_flags & SA_SIGINFO) && previous->sa_sigaction) {
+        previous->sa_sigaction(sig, info, context);
+        return;
+    }
+    if (!(previous->sa_flags & SA_SIGINFO) && previous->sa_handler != SIG_DFL && previous->sa_handler != SIG_IGN) {
+        previous->sa_handler(sig);
+        return;
+    }
+    /* Default action: the signal stays blocked until we return, then kills the process (with a core). */
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* SIGSEGV/SIGBUS handler: commit pages for arena faults, crash for everything else. */
+static void handle_fault(int sig, siginfo_t *info, void *context) {
+    int saved_errno = errno;
+    uintptr_t address = (uintptr_t)info->si_addr;
+    const char *reason = " outside any guard arena\n";
+    for (size_t i = 0; i < GA_MAX_ARENAS; ++i) {
+        GuardArena *arena = atomic_load(&arenas[i]);
+        if (!arena) {
+            continue;
+        }
+        uintptr_t base = (uintptr_t)arena->base;
+        if (address < base || address >= base + arena->reserved + arena->page_bytes) {
+            continue;
+        }
+        if (address >= base + arena->reserved) {
+            reason = " in a guard arena's guard page (overflow)\n";
+        } else if (commit_at(arena, address - base)) {
+            errno = saved_errno;
+            return;
+        } else {
+            reason = " in a guard arena, but committing the page failed\n";
+        }
+        break;
+    }
+    write_string(sig == SIGSEGV ? "Segmentation fault at " : "Bus error at ");
+    write_address(address);
+    write_string(reason);
+    errno = saved_errno;
+    forward_signal(sig, info, context);
+}
+
+/* Installs the fault handler once, remembering any handler it replaces. */
+int ga_install_handler(void) {
+    if (handler_installed) {
+        return 0;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handle_fault;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &previous_segv) != 0) {
+        return -1;
+    }
+    /* macOS reports protection faults on mapped memory as SIGBUS. */
+    if (sigaction(SIGBUS, &action, &previous_bus) != 0) {
+        sigaction(SIGSEGV, &previous_segv, NULL);
+        return -1;
+    }
+    handler_installed = 1;
+    return 0;
+}
+
+/* Reserves the range plus a guard page and registers it with the handler. */
+GuardArena *ga_create(size_t reserve_bytes, size_t initial_batch, size_t max_batch) {
+    size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+    if (reserve_bytes == 0 || ga_install_handler() != 0) {
+        return NULL;
+    }
+    GuardArena *arena = malloc(sizeof(*arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->page_bytes = page_bytes;
+    arena->reserved = round_up(reserve_bytes, page_bytes);
+    arena->used = 0;
+    arena->initial_batch = round_up(initial_batch > 0 ? initial_batch : page_bytes, page_bytes);
+    arena->max_batch = round_up(max_batch > arena->initial_batch ? max_batch : arena->initial_batch, page_bytes);
+    atomic_init(&arena->frontier, 0);
+    atomic_init(&arena->high_water, 0);
+    atomic_init(&arena->committed, 0);
+    atomic_init(&arena->batch, arena->initial_batch);
+    atomic_init(&arena->commit_faults, 0);
+    /* The bitmap is mapped too, so only the parts covering touched pages take memory. */
+    size_t page_count = arena->reserved / page_bytes;
+    arena->pages_bytes = round_up((page_count + GA_WORD_BITS - 1) / GA_WORD_BITS * sizeof(unsigned long), page_bytes);
+    void *pages = mmap(NULL, arena->pages_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                       -1, 0);
+    if (pages == MAP_FAILED) {
+        free(arena);
+        return NULL;
+    }
+    arena->pages = pages;
+    void *base = mmap(NULL, arena->reserved + page_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                      -1, 0);
+    if (base == MAP_FAILED) {
+        munmap(pages, arena->pages_bytes);
+        free(arena);
+        return NULL;
+    }
+    arena->base = base;
+
+    for (size_t i = 0; i < GA_MAX_ARENAS; ++i) {
+        GuardArena *expected = NULL;
+        if (atomic_compare_exchange_strong(&arenas[i], &expected, arena)) {
+            return arena;
+        }
+    }
+    munmap(base, arena->reserved + page_bytes);
+    munmap(pages, arena->pages_bytes);
+    free(arena);
+    errno = ENOSPC;
+    return NULL;
+}
+
+/* Bumps the offset; the pages are committed when the caller touches them. */
+void *ga_alloc(GuardArena *arena, size_t bytes) {
+    size_t start = round_up(arena->used, GA_ALIGNMENT);
+    if (start > arena->reserved || bytes > arena->reserved - start) {
+        return NULL;
+    }
+    arena->used = start + bytes;
+    return arena->base + start;
+}
+
+void *ga_base(const GuardArena *arena) {
+    return arena->base;
+}
+
+/* Mapping fresh PROT_NONE pages over the committed part both revokes access and frees the memory. */
+void ga_reset(GuardArena *arena) {
+    size_t high_water = atomic_load(&arena->high_water);
+    if (high_water > 0) {
+        mmap(arena->base, high_water, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        mmap((void *)arena->pages, arena->pages_bytes, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    }
+    atomic_store(&arena->frontier, 0);
+    atomic_store(&arena->high_water, 0);
+    atomic_store(&arena->committed, 0);
+    atomic_store(&arena->batch, arena->initial_batch);
+    arena->used = 0;
+}
+
+/* Unregisters first so the handler never sees an unmapped arena. */
+void ga_destroy(GuardArena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < GA_MAX_ARENAS; ++i) {
+        GuardArena *expected = arena;
+        if (atomic_compare_exchange_strong(&arenas[i], &expected, NULL)) {
+            break;
+        }
+    }
+    munmap(arena->base, arena->reserved + arena->page_bytes);
+    munmap((void *)arena->pages, arena->pages_bytes);
+    free(arena);
+}
+
+size_t ga_reserved(const GuardArena *arena) {
+    return arena->reserved;
+}
+
+size_t ga_committed(const GuardArena *arena) {
+    return atomic_load(&arena->committed);
+}
+
+size_t ga_commit_faults(const GuardArena *arena) {
+    return atomic_load(&arena->commit_faults);
+}
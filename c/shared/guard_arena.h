@@ -0,0 +1,50 @@
+/**
+ * @file guard_arena.h
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Declares a reserve-then-commit arena. A large PROT_NONE address range is
+ * reserved up front and a SIGSEGV handler commits pages on first touch, so a
+ * growable table can live at a fixed address without paying for memory it
+ * has not used yet. Faults outside every arena still crash the program.
+ */
+
+#ifndef GUARD_ARENA_H
+#define GUARD_ARENA_H
+
+#include <stddef.h>
+
+/* Upper bound on arenas alive at once; the handler scans a fixed table. */
+#define GA_MAX_ARENAS 16
+
+typedef struct GuardArena GuardArena;
+
+/*
+ * Installs the SIGSEGV/SIGBUS handler (once; later calls are no-ops).
+ * Returns 0 on success, -1 with errno set on failure.
+ */
+int ga_install_handler(void);
+/*
+ * Reserves reserve_bytes of address space. The first fault commits
+ * initial_batch bytes and every later fault doubles the batch up to
+ * max_batch, so a sequential fill takes O(log n) faults; a fault more than
+ * one batch past the committed prefix commits just that page. Pass the page size for both
+ * to commit one page per fault. Returns NULL on failure.
+ */
+GuardArena *ga_create(size_t reserve_bytes, size_t initial_batch, size_t max_batch);
+/* Bump-allocates bytes (16-byte aligned) without committing; NULL when the reservation is full. */
+void *ga_alloc(GuardArena *arena, size_t bytes);
+/* Start of the reserved range, for callers that index it directly as a table. */
+void *ga_base(const GuardArena *arena);
+/* Rewinds the arena and returns committed pages to the kernel. */
+void ga_reset(GuardArena *arena);
+/* Unregisters the arena and unmaps the reservation. */
+void ga_destroy(GuardArena *arena);
+
+size_t ga_reserved(const GuardArena *arena);
+/* Bytes the handler has made writable, each page counted once. */
+size_t ga_committed(const GuardArena *arena);
+/* Number of faults the handler resolved by committing pages for this arena. */
+size_t ga_commit_faults(const GuardArena *arena);
+
+#endif /* GUARD_ARENA_H */
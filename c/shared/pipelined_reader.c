@@ -0,0 +1,526 @@
+#define _POSIX_C_SOURCE 200809L
+/* fopencookie (glibc) and funopen (BSD/macOS) are extensions. */
+#define _GNU_SOURCE
+#define _DARWIN_C_SOURCE
+
+/**
+ * @file pipelined_reader.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Implements the read-ahead pipeline. The ring is an array of depth buffers
+ * guarded by one mutex: the I/O thread fills the slot at head while fewer
+ * than depth slots are filled or held, and the consumer takes the slot at
+ * tail and holds it until its next call. Only slot bookkeeping happens under
+ * the lock; reads and consuming run unlocked. The I/O thread waits for a free
+ * slot on a condition variable, but the consumer waits for data in poll on a
+ * notification pipe, so the wake descriptor can interrupt that wait too.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipelined_reader.h"
+
+typedef struct Slot {
+    unsigned char *data;
+    size_t length;
+} Slot;
+
+struct PipelinedReader {
+    int fd;
+    int use_pread;
+    int threaded;                   /* 0 for depth 0: pr_next reads on the caller's thread */
+    off_t read_offset;              /* I/O thread: where the next pread starts */
+    size_t buffer_bytes;
+    size_t depth;
+    Slot *slots;
+
+    pthread_mutex_t lock;
+    int notify[2];                  /* written by the I/O thread when it fills a slot for a waiting consumer */
+    int stop[2];                    /* written by pr_close to end a pipe read that is waiting for input */
+    pthread_cond_t drained;         /* signalled by the consumer */
+    size_t head;                    /* next slot to fill */
+    size_t tail;                    /* next slot to consume */
+    size_t count;                   /* filled slots not yet taken */
+    int holding;                    /* the consumer is still using the slot before tail */
+    int consumer_waiting;           /* the consumer is blocked in pr_next */
+    int finished;                   /* end of input or a read error */
+    int error;                      /* errno of the failed read, 0 at end of input */
+    int stopping;
+    pthread_t thread;
+    PrStats stats;
+
+    int wake_fd;
+    PrWakeHandler wake_handler;
+    void *wake_arg;
+
+    /* Consumer side of the stdio view. */
+    FILE *stream;
+    const unsigned char *current;
+    size_t current_length;
+    size_t current_used;
+    off_t position;                 /* file offset of the next byte given to stdio */
+};
+
+static double elapsed_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Wake a consumer blocked in pr_next. A full pipe already holds a wake-up. */
+static void notify_consumer(PipelinedReader *reader) {
+    ssize_t n;
+    do {
+        n = write(reader->notify[1], "", 1);
+    } while (n < 0 && errno == EINTR);
+}
+
+static void drain_notifications(PipelinedReader *reader) {
+    char buffer[64];
+    while (read(reader->notify[0], buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+/*
+ * Wait until fd is readable (fd < 0 waits for nothing), running the wake
+ * handler if the wake descriptor fired first. Returns 1 once fd is readable,
+ * 0 if it is not yet, and -1 with errno EINTR if the handler asked to stop.
+ */
+static int wait_readable(PipelinedReader *reader, int fd, int timeout_ms) {
+    struct pollfd fds[2] = {{fd, POLLIN, 0}, {reader->wake_fd, POLLIN, 0}};
+    int ready = poll(fds, reader->wake_handler ? 2 : 1, timeout_ms);
+    if (ready < 0) {
+        /* A signal's self-pipe byte is still there for the next poll; anything else, let the read report. */
+        return errno == EINTR ? 0 : 1;
+    }
+    if (reader->wake_handler && (fds[1].revents & POLLIN) && reader->wake_handler(reader->wake_arg) != 0) {
+        errno = EINTR;
+        return -1;
+    }
+    return fds[0].revents != 0;
+}
+
+static int consumer_is_waiting(PipelinedReader *reader) {
+    pthread_mutex_lock(&reader->lock);
+    int waiting = reader->consumer_waiting;
+    pthread_mutex_unlock(&reader->lock);
+    return waiting;
+}
+
+/*
+ * Block until a pipe has input or pr_close asks the I/O thread to stop.
+ * Returns 0 when the read may go ahead and -1 once stopping.
+ */
+static int wait_for_input(PipelinedReader *reader) {
+    struct pollfd fds[2] = {{reader->fd, POLLIN, 0}, {reader->stop[0], POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;               /* let the read report the error */
+        }
+        return fds[1].revents != 0 ? -1 : 0;
+    }
+}
+
+/* Whether a read of fd would return at once: data, end of input or an error. */
+static int input_ready(int fd) {
+    struct pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+/*
+ * Fill buffer until it is full or input ends. Pipes return at most their own
+ * buffer (64 KiB on Linux) per read, so without this the ring would hold only
+ * a few small chunks. A pipe only blocks for the first bytes: once some are
+ * in, a partial buffer is handed over as soon as nothing more is ready or the
+ * consumer is starving. The first read waits in poll alongside the stop pipe,
+ * so pr_close never has to interrupt a blocked read. Returns the bytes read,
+ * or -1 if nothing could be (0 at end of input or when stopping).
+ */
+static ssize_t fill_buffer(PipelinedReader *reader, unsigned char *buffer) {
+    size_t filled = 0;
+    while (filled < reader->buffer_bytes) {
+        size_t want = reader->buffer_bytes - filled;
+        if (!reader->use_pread && filled == 0 && wait_for_input(reader) != 0) {
+            return 0;
+        }
+        ssize_t n = reader->use_pread ? pread(reader->fd, buffer + filled, want, reader->read_offset)
+                                      : read(reader->fd, buffer + filled, want);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            /* An error after a partial fill surfaces on the next call, which reads again. */
+            return filled > 0 ? (ssize_t)filled : n;
+        }
+        reader->read_offset += n;
+        filled += (size_t)n;
+        if (!reader->use_pread && (!input_ready(reader->fd) || consumer_is_waiting(reader))) {
+            break;
+        }
+    }
+    return (ssize_t)filled;
+}
+
+/* I/O thread: fill free slots until end of input, an error, or pr_close. */
+static void *io_thread_main(void *arg) {
+    PipelinedReader *reader = arg;
+    struct timespec start;
+    for (;;) {
+        pthread_mutex_lock(&reader->lock);
+        if (reader->count + (size_t)reader->holding >= reader->depth && !reader->stopping) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (reader->count + (size_t)reader->holding >= reader->depth && !reader->stopping) {
+                pthread_cond_wait(&reader->drained, &reader->lock);
+            }
+            reader->stats.producer_wait_seconds += elapsed_since(&start);
+        }
+        if (reader->stopping) {
+            pthread_mutex_unlock(&reader->lock);
+            return NULL;
+        }
+        Slot *slot = &reader->slots[reader->head];
+        pthread_mutex_unlock(&reader->lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ssize_t n = fill_buffer(reader, slot->data);
+        int read_errno = errno;
+        double read_seconds = elapsed_since(&start);
+
+        pthread_mutex_lock(&reader->lock);
+        reader->stats.read_seconds += read_seconds;
+        if (n <= 0) {
+            reader->finished = 1;
+            reader->error = n < 0 ? read_errno : 0;
+        } else {
+            slot->length = (size_t)n;
+            reader->head = (reader->head + 1) % reader->depth;
+            ++reader->count;
+        }
+        if (reader->consumer_waiting) {
+            notify_consumer(reader);
+        }
+        pthread_mutex_unlock(&reader->lock);
+        if (n <= 0) {
+            return NULL;
+        }
+    }
+}
+
+/* Frees the buffers and the notification and stop pipes of a reader whose thread is not running. */
+static void free_reader(PipelinedReader *reader) {
+    for (size_t i = 0; i < reader->depth; ++i) {
+        free(reader->slots[i].data);
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (reader->notify[i] >= 0) {
+            close(reader->notify[i]);
+        }
+        if (reader->stop[i] >= 0) {
+            close(reader->stop[i]);
+        }
+    }
+    free(reader->slots);
+    free(reader);
+}
+
+/* Both ends non-blocking: a writer never stalls on a full pipe, and draining stops when it is empty. */
+static int open_signal_pipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        int flags = fcntl(fds[i], F_GETFL);
+        if (flags < 0 || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) != 0 ||
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Allocates the ring and starts the I/O thread with every signal blocked, so handlers run on the caller's thread. */
+PipelinedReader *pr_open(int fd, off_t start, size_t buffer_bytes, size_t depth) {
+    size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+    buffer_bytes = buffer_bytes > 0 ? buffer_bytes : PR_DEFAULT_BUFFER_BYTES;
+    buffer_bytes = (buffer_bytes + page_bytes - 1) / page_bytes * page_bytes;
+    int threaded = depth > 0;
+    depth = !threaded ? 1 : depth >= 2 ? depth : 2;
+
+    int seekable = lseek(fd, 0, SEEK_CUR) >= 0;
+    if (!seekable && start != 0) {
+        errno = ESPIPE;
+        return NULL;
+    }
+    PipelinedReader *reader = calloc(1, sizeof(*reader));
+    if (!reader) {
+        return NULL;
+    }
+    reader->fd = fd;
+    reader->use_pread = seekable;
+    reader->threaded = threaded;
+    reader->read_offset = start;
+    reader->position = start;
+    reader->buffer_bytes = buffer_bytes;
+    reader->notify[0] = -1;
+    reader->notify[1] = -1;
+    reader->stop[0] = -1;
+    reader->stop[1] = -1;
+    reader->wake_fd = -1;
+    reader->slots = calloc(depth, sizeof(*reader->slots));
+    if (!reader->slots) {
+        free(reader);
+        return NULL;
+    }
+    for (size_t i = 0; i < depth; ++i) {
+        /* Page-aligned so the kernel copies whole pages into them. */
+        void *buffer = NULL;
+        int status = posix_memalign(&buffer, page_bytes, buffer_bytes);
+        if (status != 0) {
+            free_reader(reader);
+            errno = status;
+            return NULL;
+        }
+        reader->slots[i].data = buffer;
+        reader->depth = i + 1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (seekable) {
+        /* Advisory only: a larger kernel readahead window on top of ours. */
+        (void)posix_fadvise(fd, start, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    pthread_mutex_init(&reader->lock, NULL);
+    if (!threaded) {
+        return reader;
+    }
+    if (open_signal_pipe(reader->notify) != 0 || open_signal_pipe(reader->stop) != 0) {
+        int error = errno;
+        pthread_mutex_destroy(&reader->lock);
+        free_reader(reader);
+        errno = error;
+        return NULL;
+    }
+    pthread_cond_init(&reader->drained, NULL);
+
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int status = pthread_create(&reader->thread, NULL, io_thread_main, reader);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (status != 0) {
+        pthread_cond_destroy(&reader->drained);
+        pthread_mutex_destroy(&reader->lock);
+        free_reader(reader);
+        errno = status;
+        return NULL;
+    }
+    return reader;
+}
+
+void pr_set_wake(PipelinedReader *reader, int wake_fd, PrWakeHandler handler, void *arg) {
+    reader->wake_fd = wake_fd;
+    reader->wake_arg = arg;
+    reader->wake_handler = handler;
+}
+
+/* depth 0: read the next buffer on the caller's thread, waiting in poll so a wake-up can interrupt a stalled input. */
+static ssize_t read_synchronously(PipelinedReader *reader, const unsigned char **data) {
+    unsigned char *buffer = reader->slots[0].data;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ssize_t n = -1;
+    for (;;) {
+        int ready = wait_readable(reader, reader->fd, -1);
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready == 0) {
+            continue;
+        }
+        n = reader->use_pread ? pread(reader->fd, buffer, reader->buffer_bytes, reader->read_offset)
+                              : read(reader->fd, buffer, reader->buffer_bytes);
+        if (n >= 0 || errno != EINTR) {
+            break;
+        }
+    }
+    int read_errno = errno;
+    double seconds = elapsed_since(&start);
+    /* Every read is one the consumer waited for: nothing is read ahead. */
+    reader->stats.read_seconds += seconds;
+    reader->stats.consumer_wait_seconds += seconds;
+    if (n <= 0) {
+        errno = read_errno;
+        return n;
+    }
+    reader->read_offset += n;
+    ++reader->stats.buffers;
+    reader->stats.bytes += (size_t)n;
+    *data = buffer;
+    return n;
+}
+
+ssize_t pr_next(PipelinedReader *reader, const unsigned char **data) {
+    if (!reader->threaded) {
+        return read_synchronously(reader, data);
+    }
+    pthread_mutex_lock(&reader->lock);
+    if (reader->holding) {
+        reader->holding = 0;
+        pthread_cond_signal(&reader->drained);
+    }
+    pthread_mutex_unlock(&reader->lock);
+    /* Checked even when a buffer is ready, so a long stretch without words still notices a wake-up. */
+    if (reader->wake_handler && wait_readable(reader, -1, 0) < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    if (reader->count == 0 && !reader->finished) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while (reader->count == 0 && !reader->finished) {
+            reader->consumer_waiting = 1;
+            pthread_mutex_unlock(&reader->lock);
+            int ready = wait_readable(reader, reader->notify[0], -1);
+            drain_notifications(reader);
+            pthread_mutex_lock(&reader->lock);
+            reader->consumer_waiting = 0;
+            if (ready < 0) {
+                reader->stats.consumer_wait_seconds += elapsed_since(&start);
+                pthread_mutex_unlock(&reader->lock);
+                errno = EINTR;
+                return -1;
+            }
+        }
+        reader->stats.consumer_wait_seconds += elapsed_since(&start);
+    }
+    if (reader->count == 0) {
+        int error = reader->error;
+        pthread_mutex_unlock(&reader->lock);
+        if (error != 0) {
+            errno = error;
+            return -1;
+        }
+        return 0;
+    }
+    Slot *slot = &reader->slots[reader->tail];
+    reader->tail = (reader->tail + 1) % reader->depth;
+    --reader->count;
+    reader->holding = 1;
+    ++reader->stats.buffers;
+    reader->stats.bytes += slot->length;
+    pthread_mutex_unlock(&reader->lock);
+    *data = slot->data;
+    return (ssize_t)slot->length;
+}
+
+/* stdio read callback: copy out of the current buffer, fetching the next one when it runs dry. */
+static ssize_t stream_read(void *cookie, char *buffer, size_t size) {
+    PipelinedReader *reader = cookie;
+    if (reader->current_used == reader->current_length) {
+        ssize_t n = pr_next(reader, &reader->current);
+        if (n <= 0) {
+            return n;
+        }
+        reader->current_length = (size_t)n;
+        reader->current_used = 0;
+    }
+    size_t available = reader->current_length - reader->current_used;
+    size_t n = size < available ? size : available;
+    memcpy(buffer, reader->current + reader->current_used, n);
+    reader->current_used += n;
+    reader->position += (off_t)n;
+    return (ssize_t)n;
+}
+
+/* Answer position queries (ftello) only; the pipeline cannot seek. */
+static int stream_tell(PipelinedReader *reader, off_t *offset, int whence) {
+    if ((whence == SEEK_CUR && *offset == 0) || (whence == SEEK_SET && *offset == reader->position)) {
+        *offset = reader->position;
+        return 0;
+    }
+    errno = ESPIPE;
+    return -1;
+}
+
+/* pr_close owns the teardown, so closing the stdio side does nothing. */
+static int stream_close(void *cookie) {
+    (void)cookie;
+    return 0;
+}
+
+#if defined(__GLIBC__)
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+    off_t position = (off_t)*offset;
+    int status = stream_tell(cookie, &position, whence);
+    *offset = position;
+    return status;
+}
+
+FILE *pr_stream(PipelinedReader *reader) {
+    if (!reader->stream) {
+        cookie_io_functions_t functions = {stream_read, NULL, stream_seek, stream_close};
+        reader->stream = fopencookie(reader, "r", functions);
+    }
+    return reader->stream;
+}
+#else
+static int stream_read_int(void *cookie, char *buffer, int size) {
+    return (int)stream_read(cookie, buffer, (size_t)size);
+}
+
+static fpos_t stream_seek(void *cookie, fpos_t offset, int whence) {
+    off_t position = (off_t)offset;
+    return stream_tell(cookie, &position, whence) == 0 ? (fpos_t)position : (fpos_t)-1;
+}
+
+FILE *pr_stream(PipelinedReader *reader) {
+    if (!reader->stream) {
+        reader->stream = funopen(reader, stream_read_int, NULL, stream_seek, stream_close);
+    }
+    return reader->stream;
+}
+#endif
+
+void pr_stats(PipelinedReader *reader, PrStats *stats) {
+    pthread_mutex_lock(&reader->lock);
+    *stats = reader->stats;
+    pthread_mutex_unlock(&reader->lock);
+}
+
+void pr_close(PipelinedReader *reader) {
+    if (!reader) {
+        return;
+    }
+    if (reader->stream) {
+        fclose(reader->stream);
+    }
+    if (reader->threaded) {
+        pthread_mutex_lock(&reader->lock);
+        reader->stopping = 1;
+        pthread_cond_signal(&reader->drained);
+        pthread_mutex_unlock(&reader->lock);
+        /* A pipe read waits in poll on the stop pipe, so a stalled writer cannot hold up the join. */
+        ssize_t n;
+        do {
+            n = write(reader->stop[1], "", 1);
+        } while (n < 0 && errno == EINTR);
+        pthread_join(reader->thread, NULL);
+        pthread_cond_destroy(&reader->drained);
+    }
+    pthread_mutex_destroy(&reader->lock);
+    free_reader(reader);
+}
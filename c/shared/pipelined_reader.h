@@ -0,0 +1,71 @@
+/**
+ * @file pipelined_reader.h
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Declares a read-ahead pipeline: a dedicated I/O thread fills large
+ * page-aligned buffers from a file descriptor and hands them to the consumer
+ * through a bounded ring, so reading the next buffer overlaps with processing
+ * the current one. The consumer can take raw buffers or a stdio FILE view,
+ * and can be woken out of a stalled read through a descriptor such as a
+ * signal handler's self-pipe.
+ */
+
+#ifndef PIPELINED_READER_H
+#define PIPELINED_READER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define PR_DEFAULT_BUFFER_BYTES (1 << 20)
+#define PR_DEFAULT_DEPTH 4          /* buffers in the ring; one is being consumed, the rest read ahead */
+
+typedef struct PipelinedReader PipelinedReader;
+
+/*
+ * Runs on the consumer's thread, inside pr_next (and so inside reads on the
+ * stream), when the wake descriptor is readable. It must drain the
+ * descriptor. Return nonzero to fail the read with EINTR, 0 to carry on.
+ */
+typedef int (*PrWakeHandler)(void *arg);
+
+typedef struct PrStats {
+    size_t buffers;                 /* buffers handed to the consumer */
+    size_t bytes;
+    double read_seconds;            /* I/O thread inside read/pread */
+    double producer_wait_seconds;   /* I/O thread waiting for a free buffer: consuming is the bottleneck */
+    double consumer_wait_seconds;   /* consumer waiting for data: I/O is the bottleneck */
+} PrStats;
+
+/*
+ * Starts reading fd at byte start on a new thread. Seekable files are read
+ * with pread and get a sequential-access hint; pipes and terminals fall back
+ * to read from the current position and require start == 0. depth 0 starts
+ * no thread: pr_next reads one buffer at a time on the caller's thread. The
+ * caller keeps ownership of fd. Returns NULL with errno set on failure.
+ */
+PipelinedReader *pr_open(int fd, off_t start, size_t buffer_bytes, size_t depth);
+/*
+ * Releases the previous buffer and waits for the next one. Returns its length
+ * with *data pointing at it (valid until the next call), 0 at end of input,
+ * or -1 with errno set if a read failed or the wake handler stopped it (EINTR).
+ */
+ssize_t pr_next(PipelinedReader *reader, const unsigned char **data);
+/*
+ * A read-only stdio stream over the pipeline (created on first call).
+ * ftello reports the logical file offset; other seeks fail. Do not fclose it:
+ * pr_close does.
+ */
+FILE *pr_stream(PipelinedReader *reader);
+/*
+ * Checks wake_fd before every buffer and while waiting for input, so a
+ * wake-up is seen within one buffer even when the input has stalled. The
+ * caller keeps ownership of wake_fd.
+ */
+void pr_set_wake(PipelinedReader *reader, int wake_fd, PrWakeHandler handler, void *arg);
+/* Snapshot of the pipeline's counters. */
+void pr_stats(PipelinedReader *reader, PrStats *stats);
+/* Stops the I/O thread (interrupting a blocked read), closes the stream and frees the buffers. */
+void pr_close(PipelinedReader *reader);
+
+#endif /* PIPELINED_READER_H */
@@ -0,0 +1,556 @@
+/* REG_RIP, dladdr and dl_iterate_phdr are GNU extensions. */
+#define _GNU_SOURCE
+
+/**
+ * @file sampling_profiler.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Implements the SIGPROF sampling profiler. The handler only touches
+ * preallocated memory: it unwinds with backtrace() (warmed up once in
+ * prof_start so libgcc is already loaded) and publishes the frames into a
+ * bounded multi-producer ring of per-slot sequence numbers. A full ring
+ * drops the sample and counts it instead of blocking. A consumer thread,
+ * with every signal blocked, drains the ring into a hash table of distinct
+ * stacks. At exit the stacks are symbolized, from the executable's ELF
+ * symbol table (which includes static functions) and then dladdr, and
+ * written one per line as "root;caller;leaf count".
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ucontext.h>
+#endif
+
+#include "sampling_profiler.h"
+
+#define PROF_RING_MASK (PROF_RING_SAMPLES - 1)
+#define PROF_HANDLER_FRAMES 4       /* handler + trampoline frames above the interrupted PC */
+#define PROF_DRAIN_INTERVAL_NS 10000000L
+
+typedef struct ProfSample {
+    _Atomic size_t sequence;    /* == index: free; == index + 1: filled; see ring_push */
+    int depth;
+    void *pcs[PROF_MAX_DEPTH];  /* pcs[0] is the interrupted PC, the rest are return addresses */
+} ProfSample;
+
+typedef struct StackEntry {
+    uint64_t hash;
+    size_t count;
+    int depth;
+    void **pcs;
+} StackEntry;
+
+typedef struct ProfSymbol {
+    uintptr_t start;
+    uintptr_t end;
+    char *name;
+} ProfSymbol;
+
+static ProfSample ring[PROF_RING_SAMPLES];
+static _Atomic size_t ring_head;
+static size_t ring_tail;                /* consumer only */
+static _Atomic size_t samples_dropped;
+
+static StackEntry *stacks = NULL;
+static size_t stack_count = 0;
+static size_t stack_capacity = 0;
+static size_t samples_taken = 0;
+
+static ProfSymbol *symbols = NULL;
+static size_t symbol_count = 0;
+
+static _Atomic int running = 0;
+static pthread_t consumer;
+static char *output_path = NULL;
+static int sample_hz = PROF_DEFAULT_HZ;
+static int exit_hook_registered = 0;
+static struct timespec cpu_started;
+#if defined(__linux__) && defined(_POSIX_CPUTIME)
+static timer_t cpu_timer;
+static int cpu_timer_armed = 0;
+#endif
+
+/* Exact PC the signal interrupted, or 0 where the context layout is unknown. */
+static uintptr_t interrupted_pc(void *context) {
+#if defined(__linux__) && defined(__x86_64__)
+    return (uintptr_t)((ucontext_t *)context)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) && defined(__aarch64__)
+    return (uintptr_t)((ucontext_t *)context)->uc_mcontext.pc;
+#else
+    (void)context;
+    return 0;
+#endif
+}
+
+/*
+ * Claim the slot at head if its sequence says it is free, fill it, then
+ * publish it by bumping the sequence. Only lock-free atomics, so it is safe
+ * in a signal handler and from several threads at once.
+ */
+static void ring_push(void *const *frames, int depth) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    for (;;) {
+        ProfSample *slot = &ring[head & PROF_RING_MASK];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == head) {
+            if (atomic_compare_exchange_weak_explicit(&ring_head, &head, head + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                slot->depth = depth;
+                memcpy(slot->pcs, frames, (size_t)depth * sizeof(*frames));
+                atomic_store_explicit(&slot->sequence, head + 1, memory_order_release);
+                return;
+            }
+        } else if (sequence < head) {
+            /* The consumer has not freed this slot yet: the ring is full. */
+            atomic_fetch_add_explicit(&samples_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        }
+    }
+}
+
+/* SIGPROF handler: unwind, drop the handler's own frames, queue the stack. */
+static void handle_sigprof(int sig, siginfo_t *info, void *context) {
+    (void)sig;
+    (void)info;
+    int saved_errno = errno;
+    void *frames[PROF_MAX_DEPTH + PROF_HANDLER_FRAMES];
+    int count = backtrace(frames, PROF_MAX_DEPTH + PROF_HANDLER_FRAMES);
+    uintptr_t pc = interrupted_pc(context);
+    int first = count > 2 ? 2 : 0;
+    for (int i = 0; i < count && i <= PROF_HANDLER_FRAMES; ++i) {
+        if ((uintptr_t)frames[i] == pc) {
+            first = i;
+            break;
+        }
+    }
+    int depth = count - first < PROF_MAX_DEPTH ? count - first : PROF_MAX_DEPTH;
+    if (depth > 0) {
+        ring_push(frames + first, depth);
+    }
+    errno = saved_errno;
+}
+
+static uint64_t hash_stack(void *const *pcs, int depth) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < depth; ++i) {
+        hash = (hash ^ (uint64_t)(uintptr_t)pcs[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Open-addressing insert; the table doubles at half load. */
+static void record_stack(void *const *pcs, int depth) {
+    if (stack_count * 2 >= stack_capacity) {
+        size_t capacity = stack_capacity ? stack_capacity * 2 : 1024;
+        StackEntry *grown = calloc(capacity, sizeof(*grown));
+        if (!grown) {
+            return;
+        }
+        for (size_t i = 0; i < stack_capacity; ++i) {
+            if (stacks[i].pcs) {
+                size_t j = stacks[i].hash & (capacity - 1);
+                while (grown[j].pcs) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                grown[j] = stacks[i];
+            }
+        }
+        free(stacks);
+        stacks = grown;
+        stack_capacity = capacity;
+    }
+    uint64_t hash = hash_stack(pcs, depth);
+    size_t j = hash & (stack_capacity - 1);
+    while (stacks[j].pcs) {
+        if (stacks[j].hash == hash && stacks[j].depth == depth &&
+            memcmp(stacks[j].pcs, pcs, (size_t)depth * sizeof(*pcs)) == 0) {
+            stacks[j].count++;
+            return;
+        }
+        j = (j + 1) & (stack_capacity - 1);
+    }
+    void **copy = malloc((size_t)depth * sizeof(*copy));
+    if (!copy) {
+        return;
+    }
+    memcpy(copy, pcs, (size_t)depth * sizeof(*copy));
+    stacks[j].hash = hash;
+    stacks[j].count = 1;
+    stacks[j].depth = depth;
+    stacks[j].pcs = copy;
+    stack_count++;
+}
+
+/* Move every published sample into the stack table and free its slot. */
+static void drain_ring(void) {
+    for (;;) {
+        ProfSample *slot = &ring[ring_tail & PROF_RING_MASK];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != ring_tail + 1) {
+            return;
+        }
+        record_stack(slot->pcs, slot->depth);
+        samples_taken++;
+        atomic_store_explicit(&slot->sequence, ring_tail + PROF_RING_SAMPLES, memory_order_release);
+        ring_tail++;
+    }
+}
+
+static void *consumer_main(void *unused) {
+    (void)unused;
+    struct timespec interval = {0, PROF_DRAIN_INTERVAL_NS};
+    while (atomic_load(&running)) {
+        drain_ring();
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+#ifdef __linux__
+static int find_main_bias(struct dl_phdr_info *info, size_t size, void *data) {
+    (void)size;
+    *(uintptr_t *)data = (uintptr_t)info->dlpi_addr;
+    return 1;   /* the first object is the executable */
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const ProfSymbol *left = a;
+    const ProfSymbol *right = b;
+    return left->start < right->start ? -1 : left->start > right->start;
+}
+
+/* Read STT_FUNC entries from /proc/self/exe's .symtab; dladdr only sees exported names. */
+static void load_symbols(void) {
+    int fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    void *image = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ElfW(Ehdr))) {
+        image = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (image == MAP_FAILED) {
+        return;
+    }
+    const unsigned char *bytes = image;
+    const ElfW(Ehdr) *header = image;
+    uintptr_t bias = 0;
+    dl_iterate_phdr(find_main_bias, &bias);
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) == 0 && header->e_shoff > 0 &&
+        header->e_shoff + (size_t)header->e_shnum * sizeof(ElfW(Shdr)) <= (size_t)info.st_size) {
+        const ElfW(Shdr) *sections = (const ElfW(Shdr) *)(bytes + header->e_shoff);
+        for (size_t s = 0; s < header->e_shnum; ++s) {
+            if (sections[s].sh_type != SHT_SYMTAB || sections[s].sh_link >= header->e_shnum) {
+                continue;
+            }
+            const ElfW(Sym) *table = (const ElfW(Sym) *)(bytes + sections[s].sh_offset);
+            const char *names = (const char *)(bytes + sections[sections[s].sh_link].sh_offset);
+            size_t count = sections[s].sh_size / sizeof(ElfW(Sym));
+            ProfSymbol *grown = realloc(symbols, (symbol_count + count) * sizeof(*symbols));
+            if (!grown) {
+                break;
+            }
+            symbols = grown;
+            for (size_t i = 0; i < count; ++i) {
+                if (ELF32_ST_TYPE(table[i].st_info) != STT_FUNC || table[i].st_value == 0) {
+                    continue;
+                }
+                ProfSymbol *symbol = &symbols[symbol_count];
+                symbol->start = bias + table[i].st_value;
+                symbol->end = symbol->start + (table[i].st_size ? table[i].st_size : 1);
+                symbol->name = strdup(names + table[i].st_name);
+                if (symbol->name) {
+                    symbol_count++;
+                }
+            }
+        }
+    }
+    munmap(image, (size_t)info.st_size);
+    qsort(symbols, symbol_count, sizeof(*symbols), compare_symbols);
+}
+#else
+static void load_symbols(void) {
+}
+#endif
+
+/* Function name for pc; falls back to the object name, then the raw address (formatted into buffer). */
+static const char *symbolize(uintptr_t pc, char *buffer, size_t size) {
+    size_t low = 0;
+    size_t high = symbol_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (symbols[mid].start <= pc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low > 0 && pc < symbols[low - 1].end) {
+        return symbols[low - 1].name;
+    }
+    Dl_info info;
+    memset(&info, 0, sizeof(info));
+    if (dladdr((void *)pc, &info) && info.dli_sname) {
+        return info.dli_sname;
+    }
+    if (info.dli_fname) {
+        /* Unnamed code (PLT stubs, stripped library internals) folds into one frame per object, as perf does. */
+        const char *slash = strrchr(info.dli_fname, '/');
+        snprintf(buffer, size, "[%s]", slash ? slash + 1 : info.dli_fname);
+    } else {
+        snprintf(buffer, size, "0x%lx", (unsigned long)pc);
+    }
+    return buffer;
+}
+
+typedef struct FoldedLine {
+    char *text;
+    size_t count;
+} FoldedLine;
+
+static int compare_lines(const void *a, const void *b) {
+    return strcmp(((const FoldedLine *)a)->text, ((const FoldedLine *)b)->text);
+}
+
+/*
+ * One line per distinct symbolized stack, outermost frame first. Stacks
+ * that differ only in PCs inside the same functions fold into one line.
+ * Returns the number of lines written.
+ */
+static size_t write_folded(FILE *out) {
+    char buffer[256];
+    FoldedLine *lines = calloc(stack_count ? stack_count : 1, sizeof(*lines));
+    size_t line_count = 0;
+    size_t written = 0;
+    if (!lines) {
+        return 0;
+    }
+    for (size_t i = 0; i < stack_capacity; ++i) {
+        const StackEntry *entry = &stacks[i];
+        char *text = NULL;
+        size_t length = 0;
+        FILE *line;
+        if (!entry->pcs || !(line = open_memstream(&text, &length))) {
+            continue;
+        }
+        for (int f = entry->depth - 1; f >= 0; --f) {
+            /* Return addresses point after the call; step back into it. */
+            uintptr_t pc = (uintptr_t)entry->pcs[f] - (f > 0 ? 1 : 0);
+            fputs(symbolize(pc, buffer, sizeof(buffer)), line);
+            if (f > 0) {
+                fputc(';', line);
+            }
+        }
+        fclose(line);
+        lines[line_count].text = text;
+        lines[line_count].count = entry->count;
+        line_count++;
+    }
+    qsort(lines, line_count, sizeof(*lines), compare_lines);
+    for (size_t i = 0; i < line_count; ++i) {
+        size_t count = lines[i].count;
+        while (i + 1 < line_count && strcmp(lines[i].text, lines[i + 1].text) == 0) {
+            free(lines[i].text);
+            count += lines[++i].count;
+        }
+        fprintf(out, "%s %zu\n", lines[i].text, count);
+        free(lines[i].text);
+        written++;
+    }
+    free(lines);
+    return written;
+}
+
+/*
+ * Arm (or, for 0, disarm) the sampling clock: a POSIX timer on
+ * CLOCK_PROCESS_CPUTIME_ID where available, else setitimer(ITIMER_PROF).
+ * Both count CPU time across all threads. The kernel checks CPU timers on
+ * the scheduler tick, so the rate achieved is capped at CONFIG_HZ;
+ * prof_stop reports it.
+ */
+static int set_interval(int frequency_hz) {
+#if defined(__linux__) && defined(_POSIX_CPUTIME)
+    if (frequency_hz > 0 && !cpu_timer_armed) {
+        struct sigevent event;
+        memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_SIGNAL;
+        event.sigev_signo = SIGPROF;
+        cpu_timer_armed = timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &cpu_timer) == 0;
+    }
+    if (cpu_timer_armed) {
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        if (frequency_hz > 0) {
+            /* Below 2 Hz the period is a second or more, which tv_nsec cannot hold. */
+            long long nsec = 1000000000LL / frequency_hz;
+            spec.it_interval.tv_sec = (time_t)(nsec / 1000000000LL);
+            spec.it_interval.tv_nsec = (long)(nsec % 1000000000LL);
+            spec.it_value = spec.it_interval;
+            return timer_settime(cpu_timer, 0, &spec, NULL);
+        }
+        timer_delete(cpu_timer);
+        cpu_timer_armed = 0;
+        return 0;
+    }
+#endif
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    if (frequency_hz > 0) {
+        long long usec = 1000000LL / frequency_hz;
+        usec = usec > 0 ? usec : 1;
+        timer.it_interval.tv_sec = (time_t)(usec / 1000000LL);
+        timer.it_interval.tv_usec = (suseconds_t)(usec % 1000000LL);
+    }
+    timer.it_value = timer.it_interval;
+    return setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+int prof_start(const char *folded_path, int frequency_hz) {
+    if (atomic_load(&running) || !folded_path || frequency_hz <= 0) {
+        return -1;
+    }
+    output_path = strdup(folded_path);
+    if (!output_path) {
+        return -1;
+    }
+    sample_hz = frequency_hz;
+
+    /* The first backtrace() loads libgcc_s; do it here, not inside the handler. */
+    void *warmup[4];
+    backtrace(warmup, 4);
+    for (size_t i = 0; i < PROF_RING_SAMPLES; ++i) {
+        atomic_init(&ring[i].sequence, i);
+    }
+    atomic_store(&ring_head, 0);
+    ring_tail = 0;
+    atomic_store(&samples_dropped, 0);
+    samples_taken = 0;
+
+    /* The consumer inherits a fully blocked mask, so SIGPROF always lands on a profiled thread. */
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &previous);
+    atomic_store(&running, 1);
+    int failed = pthread_create(&consumer, NULL, consumer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (failed) {
+        atomic_store(&running, 0);
+        free(output_path);
+        output_path = NULL;
+        return -1;
+    }
+
+    struct sigaction action;
+    struct sigaction old_action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handle_sigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    int installed = sigaction(SIGPROF, &action, &old_action) == 0;
+    if (!installed || set_interval(frequency_hz) != 0) {
+        /* Disarm whatever was armed and put the caller's SIGPROF action back. */
+        set_interval(0);
+        if (installed) {
+            sigaction(SIGPROF, &old_action, NULL);
+        }
+        atomic_store(&running, 0);
+        pthread_join(consumer, NULL);
+        free(output_path);
+        output_path = NULL;
+        return -1;
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_started);
+    if (!exit_hook_registered) {
+        atexit(prof_stop);
+        exit_hook_registered = 1;
+    }
+    return 0;
+}
+
+void prof_stop(void) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    set_interval(0);
+    signal(SIGPROF, SIG_IGN);
+    struct timespec cpu_stopped;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_stopped);
+    double cpu_seconds = (double)(cpu_stopped.tv_sec - cpu_started.tv_sec) +
+                         (double)(cpu_stopped.tv_nsec - cpu_started.tv_nsec) / 1e9;
+    atomic_store(&running, 0);
+    pthread_join(consumer, NULL);
+    drain_ring();
+
+    FILE *out = fopen(output_path, "w");
+    if (!out) {
+        fprintf(stderr, "Profiler: cannot write '%s': %s\n", output_path, strerror(errno));
+    } else {
+        load_symbols();
+        size_t written = write_folded(out);
+        fclose(out);
+        fprintf(stderr,
+                "Profiler: %zu samples over %.2f CPU-s (%.0f Hz achieved of %d requested, %zu dropped), "
+                "%zu distinct stacks written to %s\n",
+                samples_taken, cpu_seconds, cpu_seconds > 0 ? samples_taken / cpu_seconds : 0.0, sample_hz,
+                atomic_load(&samples_dropped), written, output_path);
+    }
+
+    for (size_t i = 0; i < stack_capacity; ++i) {
+        free(stacks[i].pcs);
+    }
+    free(stacks);
+    stacks = NULL;
+    stack_count = 0;
+    stack_capacity = 0;
+    for (size_t i = 0; i < symbol_count; ++i) {
+        free(symbols[i].name);
+    }
+    free(symbols);
+    symbols = NULL;
+    symbol_count = 0;
+    free(output_path);
+    output_path = NULL;
+}
+
+int prof_consume_options(int argc, char **argv) {
+    const char *path = NULL;
+    int frequency_hz = PROF_DEFAULT_HZ;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10] != '\0') {
+            path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--profile-hz=", 13) == 0 && atoi(argv[i] + 13) > 0) {
+            frequency_hz = atoi(argv[i] + 13);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argv[kept] = NULL;
+    if (path && prof_start(path, frequency_hz) != 0) {
+        fprintf(stderr, "Profiler: could not start; running unprofiled.\n");
+    }
+    return kept;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file sampling_profiler.h
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Declares a small in-process sampling profiler. SIGPROF fires on a
+ * process CPU-time interval from timer_create(CLOCK_PROCESS_CPUTIME_ID),
+ * falling back to setitimer(ITIMER_PROF) where POSIX timers are
+ * unavailable. The handler captures the interrupted stack into a
+ * preallocated lock-free ring, a background thread aggregates the stacks,
+ * and at exit they are symbolized and written in the folded format that
+ * flamegraph.pl and speedscope read.
+ *
+ * Tools opt in at compile time: build with -DSAMPLING_PROFILER, link
+ * sampling_profiler.c with -pthread -ldl, and call prof_consume_options first
+ * thing in main to accept --profile=FILE and --profile-hz=N.
+ */
+
+#ifndef SAMPLING_PROFILER_H
+#define SAMPLING_PROFILER_H
+
+#define PROF_DEFAULT_HZ 997         /* prime, so sampling does not alias with periodic work */
+#define PROF_MAX_DEPTH 64           /* frames kept per sample; deeper stacks are cut at the root end */
+#define PROF_RING_SAMPLES 4096      /* power of two; about 4 s of samples at the default rate */
+
+/*
+ * Starts sampling at frequency_hz samples per CPU-second and arranges for
+ * prof_stop to run at exit. Returns 0 on success, -1 on failure (the
+ * program keeps running unprofiled).
+ */
+int prof_start(const char *folded_path, int frequency_hz);
+/* Stops sampling and writes the folded stacks; safe to call more than once. */
+void prof_stop(void);
+/*
+ * Removes --profile=FILE and --profile-hz=N from argv, starting the profiler
+ * if --profile was given, and returns the new argc so the tool's own option
+ * parsing never sees them.
+ */
+int prof_consume_options(int argc, char **argv);
+
+#endif /* SAMPLING_PROFILER_H */
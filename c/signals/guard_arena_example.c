@@ -0,0 +1,206 @@
+#define _POSIX_C_SOURCE 200809L
+
+/**
+ * @file guard_arena_example.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Builds on sigsegv_example.c: instead of exiting on SIGSEGV, the handler in
+ * guard_arena.c commits pages of a reserved PROT_NONE region on demand. This
+ * program grows a table of 64-bit values by appending and compares a
+ * realloc-doubling vector with the guard arena (batched and page-at-a-time
+ * commits). --crash and --overflow show that real bugs still crash.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../shared/guard_arena.h"
+
+#define RESERVE_BYTES ((size_t)64 << 30)    /* 64 GiB of address space, none of it committed */
+#define INITIAL_BATCH_BYTES ((size_t)64 << 10)
+#define MAX_BATCH_BYTES ((size_t)64 << 20)
+#define REALLOC_INITIAL_ELEMENTS 16
+#define SPARSE_STRIDE_BYTES ((size_t)1 << 30)
+
+/* Cost of one growth strategy, measured around the whole fill. */
+typedef struct GrowthResult {
+    double seconds;
+    long minor_faults;
+    size_t grow_events;     /* realloc calls, or handler commits */
+    size_t footprint;       /* capacity in bytes, or bytes committed */
+    uint64_t checksum;
+} GrowthResult;
+
+static double seconds_between(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static long minor_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/* Sum the table so the compiler cannot drop the stores. */
+static uint64_t checksum(const uint64_t *values, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+/* Append count values to a vector that doubles its capacity with realloc. */
+static GrowthResult grow_with_realloc(size_t count) {
+    GrowthResult result = {0.0, 0, 0, 0, 0};
+    struct timespec start;
+    struct timespec end;
+    long faults_before = minor_faults();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t *values = NULL;
+    size_t capacity = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == capacity) {
+            capacity = capacity ? capacity * 2 : REALLOC_INITIAL_ELEMENTS;
+            uint64_t *grown = realloc(values, capacity * sizeof(*values));
+            if (!grown) {
+                fprintf(stderr, "realloc to %zu elements failed.\n", capacity);
+                exit(EXIT_FAILURE);
+            }
+            values = grown;
+            result.grow_events++;
+        }
+        values[i] = i * 2654435761u;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result.seconds = seconds_between(&start, &end);
+    result.minor_faults = minor_faults() - faults_before;
+    result.footprint = capacity * sizeof(*values);
+    result.checksum = checksum(values, count);
+    free(values);
+    return result;
+}
+
+/* Append count values to a table at the base of a guard arena; the handler commits as the fill advances. */
+static GrowthResult grow_with_guard_arena(size_t count, size_t initial_batch, size_t max_batch) {
+    GrowthResult result = {0.0, 0, 0, 0, 0};
+    GuardArena *arena = ga_create(RESERVE_BYTES, initial_batch, max_batch);
+    if (!arena) {
+        perror("ga_create");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t *values = ga_base(arena);
+    struct timespec start;
+    struct timespec end;
+    long faults_before = minor_faults();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = i * 2654435761u;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result.seconds = seconds_between(&start, &end);
+    result.minor_faults = minor_faults() - faults_before;
+    result.grow_events = ga_commit_faults(arena);
+    result.footprint = ga_committed(arena);
+    result.checksum = checksum(values, count);
+    ga_destroy(arena);
+    return result;
+}
+
+static void print_result(const char *label, size_t count, const GrowthResult *result) {
+    printf("%-14s\t%10zu\t%8.1f\t%6.2f\t%10zu\t%12ld\t%10.1f\n", label, count, result->seconds * 1e3,
+           result->seconds * 1e9 / (double)count, result->grow_events, result->minor_faults,
+           (double)result->footprint / (1 << 20));
+}
+
+/* Touch one value per GiB of the reservation: only the touched batches are committed. */
+static void sparse_demo(void) {
+    GuardArena *arena = ga_create(RESERVE_BYTES, INITIAL_BATCH_BYTES, INITIAL_BATCH_BYTES);
+    if (!arena) {
+        perror("ga_create");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *base = ga_base(arena);
+    for (size_t offset = 0; offset < ga_reserved(arena); offset += SPARSE_STRIDE_BYTES) {
+        base[offset] = 1;
+    }
+    printf("Sparse: touched %zu bytes 1 GiB apart in a %zu GiB reservation; committed %zu KiB in %zu faults.\n",
+           ga_reserved(arena) / SPARSE_STRIDE_BYTES, ga_reserved(arena) >> 30, ga_committed(arena) >> 10,
+           ga_commit_faults(arena));
+    ga_destroy(arena);
+}
+
+/* Write one byte past a small arena's reservation: the guard page turns it into a clean crash. */
+static void overflow_demo(void) {
+    GuardArena *arena = ga_create((size_t)1 << 20, INITIAL_BATCH_BYTES, MAX_BATCH_BYTES);
+    if (!arena) {
+        perror("ga_create");
+        exit(EXIT_FAILURE);
+    }
+    volatile unsigned char *base = ga_base(arena);
+    puts("Filling a 1 MiB arena, then writing one byte past the end...");
+    fflush(stdout);
+    for (size_t i = 0; i <= ga_reserved(arena); ++i) {
+        base[i] = 1;
+    }
+    puts("This message will never be displayed.");
+}
+
+int main(int argc, char **argv) {
+    size_t counts[] = {(size_t)1 << 20, (size_t)1 << 24, (size_t)1 << 26};
+    size_t count_total = sizeof(counts) / sizeof(counts[0]);
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--elements=", 11) == 0 && (counts[0] = strtoul(argv[i] + 11, NULL, 10)) > 0) {
+            count_total = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--crash") == 0) {
+            if (ga_install_handler() != 0) {
+                perror("sigaction");
+                return EXIT_FAILURE;
+            }
+            puts("Deliberately dereferencing NULL with the arena handler installed...");
+            fflush(stdout);
+            volatile int *ptr = NULL;
+            *ptr = 1234;
+            puts("This message will never be displayed.");
+            return EXIT_SUCCESS;
+        }
+        if (strcmp(argv[i], "--overflow") == 0) {
+            overflow_demo();
+            return EXIT_SUCCESS;
+        }
+        fprintf(stderr, "Usage: %s [--elements=N] [--crash] [--overflow]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t page_bytes = (size_t)sysconf(_SC_PAGESIZE);
+    printf("Growing a table of uint64_t by appending (reservation %zu GiB, batches %zu KiB .. %zu MiB):\n",
+           RESERVE_BYTES >> 30, INITIAL_BATCH_BYTES >> 10, MAX_BATCH_BYTES >> 20);
+    puts("Strategy      \tElements\tTotal ms\tns/elem\tGrow events\tMinor faults\tFootprint MiB");
+    for (size_t c = 0; c < count_total; ++c) {
+        GrowthResult realloc_result = grow_with_realloc(counts[c]);
+        GrowthResult batched = grow_with_guard_arena(counts[c], INITIAL_BATCH_BYTES, MAX_BATCH_BYTES);
+        GrowthResult per_page = grow_with_guard_arena(counts[c], page_bytes, page_bytes);
+        if (realloc_result.checksum != batched.checksum || batched.checksum != per_page.checksum) {
+            fprintf(stderr, "Checksum mismatch at %zu elements.\n", counts[c]);
+            return EXIT_FAILURE;
+        }
+        print_result("realloc x2", counts[c], &realloc_result);
+        print_result("guard batched", counts[c], &batched);
+        print_result("guard per-page", counts[c], &per_page);
+    }
+    sparse_demo();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Signals must reach word_counter while it is blocked on a stalled input.
+# Usage: sh c/word_counter/test_signals.sh [path/to/word_counter]
+#
+# A FIFO writer queues "alpha beta gam" before the counter opens the FIFO and
+# then stalls mid-word, so every run sees the same order of events: the
+# reader gets the bytes at once and must hand them over, then blocks. In both
+# the pipelined and --sync-io modes, SIGUSR1 must print a report and SIGINT
+# must exit with status 130 within a second, leaving a checkpoint that holds
+# the two complete words and stops at the boundary before "gam".
+
+binary=${1:-./word_counter}
+work=$(mktemp -d)
+writer=
+counter=
+failures=0
+
+cleanup() {
+    [ -n "$writer" ] && kill "$writer" 2>/dev/null
+    [ -n "$counter" ] && kill -9 "$counter" 2>/dev/null
+    rm -rf "$work"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL ($mode): $1"
+    failures=$((failures + 1))
+}
+
+# Wait up to one second for pid to exit.
+wait_exit() {
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        kill -0 "$1" 2>/dev/null || return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+for mode in pipelined --sync-io; do
+    flag=
+    [ "$mode" = --sync-io ] && flag=--sync-io
+    rm -f "$work/fifo" "$work/queued" "$work/checkpoint" "$work/stderr"
+    mkfifo "$work/fifo"
+    # Opening read-write does not wait for a reader (Linux), so the data is queued first.
+    sh -c 'exec 3<>"$1"; printf "alpha beta gam" >&3; : > "$2"; exec sleep 30' sh "$work/fifo" "$work/queued" &
+    writer=$!
+    while [ ! -e "$work/queued" ]; do
+        sleep 0.1
+    done
+    "$binary" $flag --checkpoint="$work/checkpoint" "$work/fifo" > /dev/null 2> "$work/stderr" &
+    counter=$!
+    sleep 0.5
+
+    kill -USR1 "$counter"
+    sleep 0.5
+    grep -q '^Progress: 11 of' "$work/stderr" || fail "no SIGUSR1 report while blocked"
+
+    kill -INT "$counter"
+    if ! wait_exit "$counter"; then
+        fail "still running 1 s after SIGINT"
+        kill -9 "$counter"
+    fi
+    wait "$counter"
+    status=$?
+    counter=
+    [ "$status" -eq 130 ] || fail "exit status $status, expected 130"
+    grep -q '^offset 11$' "$work/checkpoint" 2>/dev/null || fail "checkpoint offset is not 11"
+    grep -q '^words 2$' "$work/checkpoint" 2>/dev/null || fail "checkpoint does not hold 2 words"
+
+    kill "$writer" 2>/dev/null
+    wait "$writer" 2>/dev/null
+    writer=
+done
+
+if [ "$failures" -ne 0 ]; then
+    exit 1
+fi
+echo "PASS: SIGUSR1 and SIGINT interrupt a blocked read in both modes"
@@ -1,42 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+
 /**
  * @file word_counter.c
  * @author Max Petite
  * @date 2025-11-11
  *
  * Counts word frequencies from a text file using a linked list backend.
+ * Long runs can be inspected and interrupted safely: SIGUSR1 prints the
+ * current top words and progress, and SIGINT/SIGTERM write a checkpoint of
+ * the counts and the file offset that --resume picks up from, even while the
+ * input is stalled. --utf8 counts words in any script, case-folded, instead
+ * of ASCII letters and digits only.
+ * Input is read ahead on an I/O thread so reads overlap with counting.
  */
 
-#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../shared/linkedlist.h"
+#include "../shared/pipelined_reader.h"
+#include "word_engine.h"
+#ifdef SAMPLING_PROFILER
+#include "../shared/sampling_profiler.h"
+#endif
 
 /*
  * Extension: Robustness & Profiling (explicitly marked)
  * - Robust CLI/file handling (argc check, fopen error): already present.
  * - Empty-file handling: if no tokens are found, print a friendly message and exit.
  * - Token-length warning: warn once if any token exceeds MAX_WORD_LENGTH-1 and is truncated.
- * - Profiling note: build with `gcc -pg c/word_counter/word_counter.c linkedlist.c -o word_counter_pg`
+ * - Profiling note: build with `gcc -pg c/word_counter/word_counter.c c/word_counter/word_engine.c linkedlist.c pipelined_reader.c -pthread -o word_counter_pg`
  *   and run `gprof` as shown in README.
  */
 
 #define MAX_WORD_LENGTH 128
+#define TOP_K 20
+#define CHECKPOINT_MAGIC "wordcount-checkpoint"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_SUFFIX ".checkpoint"
+
+/*
+ * Set by the signal handlers, polled by the counting loop after every word,
+ * so all real work (sorting, stdio, writing the checkpoint) happens outside
+ * the handler. The handlers also write a byte to the self-pipe, which the
+ * reader polls, so a read blocked on a stalled input wakes up too.
+ */
+static volatile sig_atomic_t g_report_requested = 0;
+static volatile sig_atomic_t g_stop_signal = 0;
+static int g_wake_pipe[2] = {-1, -1};
+
+/* Progress shared by the SIGUSR1 report and the checkpoint. */
+typedef struct CountProgress {
+    const char *input_path;
+    off_t input_size;
+    time_t input_mtime;
+    off_t offset;           /* bytes consumed, always at a word boundary */
+    size_t words;           /* tokens counted, including any resumed ones */
+    int word_flags;         /* tokenizer mode; a resumed run must use the same one */
+    struct timespec started;
+} CountProgress;
 
 typedef struct WordCount {
     char *word;
     size_t count;
 } WordCount;
 
-/* Lowercase a word in place. */
-static void to_lowercase(char *word) {
-    for (char *p = word; *p; ++p) {
-        *p = (char)tolower((unsigned char)*p);
-    }
-}
-
 /* Heap-duplicate a NUL-terminated word. */
 static char *duplicate_word(const char *word) {
     size_t length = strlen(word) + 1;
@@ -90,47 +126,6 @@ static void add_or_increment(LinkedList *list, const char *word) {
     ll_append(list, wc);
 }
 
-/* Tokenize the next alphanumeric word from the file. */
-static int read_next_word(FILE *file, char *buffer, size_t buffer_size) {
-    int ch;
-    size_t index = 0;
-
-    while ((ch = fgetc(file)) != EOF) {
-        if (isalnum(ch) || ch == '\'') {
-            if (index + 1 < buffer_size) {
-                buffer[index++] = (char)ch;
-            } else {
-                /* Extension: record that we hit the max token length. */
-                g_truncated_token_seen = 1;
-                break;
-            }
-        } else if (index > 0) {
-            break;
-        }
-    }
-
-    if (index == 0) {
-        return 0;
-    }
-
-    buffer[index] = '\0';
-
-    size_t write_index = 0;
-    for (size_t i = 0; buffer[i] != '\0'; ++i) {
-        if (isalnum((unsigned char)buffer[i])) {
-            buffer[write_index++] = buffer[i];
-        }
-    }
-    buffer[write_index] = '\0';
-
-    if (write_index == 0) {
-        return 0;
-    }
-
-    to_lowercase(buffer);
-    return 1;
-}
-
 /* Sort comparator for descending frequency then alphabetically. */
 static int cmp_wordcount_desc(const void *a, const void *b) {
     const WordCount *wa = *(const WordCount *const *)a;
@@ -159,27 +154,242 @@ static WordCount **list_to_array(LinkedList *list, size_t *out_size) {
 }
 
 /* Emit up to 'limit' of the most frequent words. */
-static void print_top_words(LinkedList *list, size_t limit) {
+static void print_top_words(LinkedList *list, size_t limit, FILE *out) {
     size_t size = 0;
     WordCount **array = list_to_array(list, &size);
     qsort(array, size, sizeof(*array), cmp_wordcount_desc);
 
     size_t to_print = size < limit ? size : limit;
     for (size_t i = 0; i < to_print; ++i) {
-        printf("%-10s\t%zu\n", array[i]->word, array[i]->count);
+        /* Pad to 10 characters, not bytes, so --utf8 words line up (ASCII output is unchanged). */
+        int width = 10;
+        for (const char *p = array[i]->word; *p; ++p) {
+            width += ((unsigned char)*p & 0xC0) == 0x80;
+        }
+        fprintf(out, "%-*s\t%zu\n", width, array[i]->word, array[i]->count);
     }
 
     free(array);
 }
 
+/* Async-signal-safe: a full pipe already holds a wake-up, so a failed write is fine. */
+static void wake_reader(void) {
+    int saved_errno = errno;
+    ssize_t written = write(g_wake_pipe[1], "", 1);
+    (void)written;
+    errno = saved_errno;
+}
+
+static void handle_report_signal(int sig) {
+    (void)sig;
+    g_report_requested = 1;
+    wake_reader();
+}
+
+static void handle_stop_signal(int sig) {
+    g_stop_signal = sig;
+    wake_reader();
+}
+
+/*
+ * SA_RESTART keeps stdout and stderr writes from failing with EINTR. Reads
+ * do not need it: the reader waits in poll on the self-pipe, which wakes it
+ * whatever the flag.
+ */
+static void install_signal_handlers(void) {
+    if (pipe(g_wake_pipe) != 0) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < 2; ++i) {
+        int flags = fcntl(g_wake_pipe[i], F_GETFL);
+        if (flags < 0 || fcntl(g_wake_pipe[i], F_SETFL, flags | O_NONBLOCK) != 0 ||
+            fcntl(g_wake_pipe[i], F_SETFD, FD_CLOEXEC) != 0) {
+            perror("fcntl");
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = handle_report_signal;
+    if (sigaction(SIGUSR1, &action, NULL) != 0) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+    action.sa_handler = handle_stop_signal;
+    if (sigaction(SIGINT, &action, NULL) != 0 || sigaction(SIGTERM, &action, NULL) != 0) {
+        perror("sigaction");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* SIGUSR1: progress and the current top words on stderr, leaving stdout for the final result. */
+static void report_progress(LinkedList *list, const CountProgress *progress) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (double)(now.tv_sec - progress->started.tv_sec) +
+                     (double)(now.tv_nsec - progress->started.tv_nsec) / 1e9;
+    fprintf(stderr, "Progress: %lld of %lld bytes (%.1f%%), %zu words, %d distinct, %.1f s elapsed\n",
+            (long long)progress->offset, (long long)progress->input_size,
+            progress->input_size > 0 ? 100.0 * (double)progress->offset / (double)progress->input_size : 100.0,
+            progress->words, ll_size(list), elapsed);
+    fprintf(stderr, "Top %d words so far:\n", TOP_K);
+    print_top_words(list, TOP_K, stderr);
+}
+
+/* What the wake handler needs to print a SIGUSR1 report. */
+typedef struct WakeContext {
+    LinkedList *list;
+    const CountProgress *progress;
+} WakeContext;
+
+/*
+ * Runs inside a read on the counting thread once a handler has written to the
+ * self-pipe, so neither a stalled input nor a long stretch without words
+ * delays it. Returns nonzero to cut the read short for a stop.
+ */
+static int handle_wake(void *arg) {
+    const WakeContext *context = arg;
+    char drained[64];
+    while (read(g_wake_pipe[0], drained, sizeof(drained)) > 0) {
+    }
+    if (g_report_requested) {
+        g_report_requested = 0;
+        report_progress(context->list, context->progress);
+    }
+    return g_stop_signal != 0;
+}
+
+/* Checkpoint name of the tokenizer mode selected by flags. */
+static const char *tokenizer_mode(int flags) {
+    return (flags & WE_UTF8) ? "utf8" : "ascii";
+}
+
+/*
+ * Write the counts and resume offset to path. The text goes to path.tmp
+ * first and is renamed over path, so an interrupted write never replaces a
+ * good checkpoint with a partial one. Returns 0 on success.
+ */
+static int write_checkpoint(const char *path, LinkedList *list, const CountProgress *progress) {
+    size_t length = strlen(path) + sizeof(".tmp");
+    char *temporary = (char *)malloc(length);
+    if (!temporary) {
+        return -1;
+    }
+    snprintf(temporary, length, "%s.tmp", path);
+    FILE *out = fopen(temporary, "w");
+    if (!out) {
+        free(temporary);
+        return -1;
+    }
+    fprintf(out, "%s %d\nmode %s\n", CHECKPOINT_MAGIC, CHECKPOINT_VERSION, tokenizer_mode(progress->word_flags));
+    fprintf(out, "size %lld\nmtime %lld\noffset %lld\nwords %zu\ntruncated %d\ndistinct %d\n",
+            (long long)progress->input_size, (long long)progress->input_mtime, (long long)progress->offset,
+            progress->words, g_truncated_token_seen, ll_size(list));
+    for (Node *cur = list->head; cur != NULL; cur = cur->next) {
+        const WordCount *wc = (const WordCount *)cur->data;
+        fprintf(out, "%zu %s\n", wc->count, wc->word);
+    }
+    int failed = ferror(out);
+    failed |= fclose(out) != 0;
+    if (failed || rename(temporary, path) != 0) {
+        remove(temporary);
+        free(temporary);
+        return -1;
+    }
+    free(temporary);
+    return 0;
+}
+
+/*
+ * Load a checkpoint written for this input into list and progress. The
+ * input's size and mtime must match what was recorded: resuming at a byte
+ * offset into a file that has since changed would silently miscount. So must
+ * the tokenizer mode, or ASCII and case-folded UTF-8 counts would mix.
+ */
+static void load_checkpoint(const char *path, LinkedList *list, CountProgress *progress) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Failed to open checkpoint '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    char magic[32];
+    char mode[16];
+    int version = 0;
+    long long size = 0;
+    long long mtime = 0;
+    long long offset = 0;
+    int truncated = 0;
+    int distinct = 0;
+    if (fscanf(in, "%31s %d mode %15s size %lld mtime %lld offset %lld words %zu truncated %d distinct %d", magic,
+               &version, mode, &size, &mtime, &offset, &progress->words, &truncated, &distinct) != 9 ||
+        strcmp(magic, CHECKPOINT_MAGIC) != 0 || version != CHECKPOINT_VERSION || distinct < 0) {
+        fprintf(stderr, "'%s' is not a word_counter checkpoint.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (size != (long long)progress->input_size || mtime != (long long)progress->input_mtime) {
+        fprintf(stderr, "Checkpoint '%s' was written for a different version of '%s'; refusing to resume.\n", path,
+                progress->input_path);
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(mode, tokenizer_mode(progress->word_flags)) != 0) {
+        fprintf(stderr, "Checkpoint '%s' was written in %s mode but this run is %s; refusing to resume.\n", path,
+                mode, tokenizer_mode(progress->word_flags));
+        exit(EXIT_FAILURE);
+    }
+    char word[MAX_WORD_LENGTH];
+    size_t count = 0;
+    for (int i = 0; i < distinct; ++i) {
+        if (fscanf(in, "%zu %127s", &count, word) != 2) {
+            fprintf(stderr, "Checkpoint '%s' is truncated after %d of %d words.\n", path, i, distinct);
+            exit(EXIT_FAILURE);
+        }
+        WordCount *wc = create_wordcount(word);
+        wc->count = count;
+        ll_append(list, wc);
+    }
+    fclose(in);
+    progress->offset = (off_t)offset;
+    g_truncated_token_seen = truncated;
+}
+
 /* Entry point: parse args, build counts, dump top 20. */
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+#ifdef SAMPLING_PROFILER
+    argc = prof_consume_options(argc, argv);
+#endif
+    const char *filename = NULL;
+    const char *checkpoint_path = NULL;
+    const char *resume_path = NULL;
+    int word_flags = WE_KEEP_APOSTROPHES;
+    int sync_io = 0;
+    int io_stats = 0;
+    int usage_error = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--checkpoint=", 13) == 0 && argv[i][13] != '\0') {
+            checkpoint_path = argv[i] + 13;
+        } else if (strncmp(argv[i], "--resume=", 9) == 0 && argv[i][9] != '\0') {
+            resume_path = argv[i] + 9;
+        } else if (strcmp(argv[i], "--utf8") == 0) {
+            word_flags |= WE_UTF8;
+        } else if (strcmp(argv[i], "--sync-io") == 0) {
+            sync_io = 1;
+        } else if (strcmp(argv[i], "--io-stats") == 0) {
+            io_stats = 1;
+        } else if (!filename) {
+            filename = argv[i];
+        } else {
+            usage_error = 1;
+        }
+    }
+    if (!filename || usage_error) {
+        fprintf(stderr, "Usage: %s [--utf8] [--sync-io] [--io-stats] [--checkpoint=FILE] [--resume=FILE] <file>\n",
+                argv[0]);
         return EXIT_FAILURE;
     }
 
-    const char *filename = argv[1];
     FILE *file = fopen(filename, "r");
     if (!file) {
         fprintf(stderr, "Failed to open '%s': %s\n", filename, strerror(errno));
@@ -193,13 +403,114 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
+    /* Extension: checkpoint/resume state. The default checkpoint sits next to the input. */
+    CountProgress progress = {filename, 0, 0, 0, 0, word_flags, {0, 0}};
+    struct stat info;
+    if (fstat(fileno(file), &info) == 0) {
+        progress.input_size = info.st_size;
+        progress.input_mtime = info.st_mtime;
+    }
+    char *default_checkpoint = NULL;
+    if (!checkpoint_path) {
+        size_t length = strlen(filename) + sizeof(CHECKPOINT_SUFFIX);
+        default_checkpoint = (char *)malloc(length);
+        if (!default_checkpoint) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(default_checkpoint, length, "%s%s", filename, CHECKPOINT_SUFFIX);
+        checkpoint_path = default_checkpoint;
+    }
+    if (resume_path) {
+        load_checkpoint(resume_path, list, &progress);
+        if (fseeko(file, progress.offset, SEEK_SET) != 0) {
+            fprintf(stderr, "Failed to seek '%s' to %lld: %s\n", filename, (long long)progress.offset,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Resumed from '%s' at byte %lld with %zu words counted.\n", resume_path,
+                (long long)progress.offset, progress.words);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &progress.started);
+    install_signal_handlers();
+
+    /*
+     * Extension: read-ahead pipeline. An I/O thread fills PR_DEFAULT_DEPTH
+     * buffers of 1 MiB ahead of the tokenizer, which reads them through a
+     * stdio view; --sync-io reads the same buffers on this thread instead.
+     * Either way the reader polls the self-pipe, so signals interrupt a wait.
+     */
+    WakeContext wake = {list, &progress};
+    FILE *input = file;
+    PipelinedReader *reader =
+        pr_open(fileno(file), progress.offset, PR_DEFAULT_BUFFER_BYTES, sync_io ? 0 : PR_DEFAULT_DEPTH);
+    if (reader && pr_stream(reader)) {
+        input = pr_stream(reader);
+        pr_set_wake(reader, g_wake_pipe[0], handle_wake, &wake);
+    } else {
+        fprintf(stderr, "Warning: pipelined reader unavailable (%s); signals wait for the next word.\n",
+                strerror(errno));
+        pr_close(reader);
+        reader = NULL;
+    }
+
     char word_buffer[MAX_WORD_LENGTH];
-    while (read_next_word(file, word_buffer, sizeof(word_buffer))) {
+    size_t consumed = 0;
+    while (we_next_word(input, word_buffer, sizeof(word_buffer), word_flags, &g_truncated_token_seen, &consumed)) {
+        if (g_stop_signal && ferror(input)) {
+            /* A stop cut the read short, so this word may be incomplete: the resumed run counts it. */
+            break;
+        }
         add_or_increment(list, word_buffer);
+        progress.words++;
+        /* we_next_word consumed the delimiter after this word, so the offset is a clean restart point. */
+        progress.offset += (off_t)consumed;
+        if (g_report_requested) {
+            g_report_requested = 0;
+            report_progress(list, &progress);
+        }
+        if (g_stop_signal) {
+            break;
+        }
     }
+    /* Stopped mid-input: the loop broke early, or the read failed with EINTR at the wake handler's request. */
+    int stopped = g_stop_signal && (ferror(input) || !feof(input));
 
+    if (ferror(input) && !stopped) {
+        fprintf(stderr, "Failed to read '%s': %s\n", filename, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (reader) {
+        if (io_stats) {
+            PrStats stats;
+            pr_stats(reader, &stats);
+            fprintf(stderr, "I/O: %zu buffers, %zu bytes; read %.3f s, counting waited %.3f s for input, "
+                    "reader waited %.3f s for a free buffer\n",
+                    stats.buffers, stats.bytes, stats.read_seconds, stats.consumer_wait_seconds,
+                    stats.producer_wait_seconds);
+        }
+        pr_close(reader);
+    }
     fclose(file);
 
+    /* A signal that lands after the last word just lets the run finish. */
+    if (stopped) {
+        int sig = (int)g_stop_signal;
+        if (write_checkpoint(checkpoint_path, list, &progress) != 0) {
+            fprintf(stderr, "Failed to write checkpoint '%s': %s\n", checkpoint_path, strerror(errno));
+        } else {
+            fprintf(stderr, "Stopped by signal %d at byte %lld of %lld; checkpoint written to '%s'.\n"
+                    "Resume with: %s%s --resume=%s %s\n",
+                    sig, (long long)progress.offset, (long long)progress.input_size, checkpoint_path, argv[0],
+                    (word_flags & WE_UTF8) ? " --utf8" : "", checkpoint_path, filename);
+        }
+        ll_clear(list, free_wordcount);
+        free(list);
+        free(default_checkpoint);
+        return 128 + sig;
+    }
+    free(default_checkpoint);
+
     /* Extension: handle empty file (or no tokens) explicitly. */
     if (ll_size(list) == 0) {
         puts("No words found.");
@@ -209,7 +520,7 @@ int main(int argc, char **argv) {
     }
 
     puts("Top 20 words by frequency:");
-    print_top_words(list, 20);
+    print_top_words(list, TOP_K, stdout);
 
     /* Extension: warn once if any token was truncated. */
     if (g_truncated_token_seen) {
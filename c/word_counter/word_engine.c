@@ -0,0 +1,347 @@
+#define _POSIX_C_SOURCE 200809L
+
+/**
+ * @file word_engine.c
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Implements the shared word tokenizer. Bytes are read with getc_unlocked and
+ * ASCII is classified and lowercased from a fixed table instead of the
+ * locale-dependent isalnum/tolower. In UTF-8 mode, runs of ASCII take that
+ * same table path; other bytes go through a table-driven DFA decoder, and
+ * each decoded code point is checked against a range table of letters and
+ * digits and simple-case-folded.
+ */
+
+#include <stdint.h>
+
+#include "word_engine.h"
+
+/* Lowercased byte for ASCII letters and digits, 0 for everything else. */
+static const unsigned char ascii_fold[128] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+    0, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0, 0, 0, 0, 0,
+};
+
+/*
+ * UTF-8 DFA. Every byte maps to a class; the decoder state and the class pick
+ * the next state. Classes: 0 ASCII, 1 80-8F, 2 90-9F, 3 A0-BF (continuation
+ * bytes, split where E0/ED/F0/F4 restrict the second byte), 4 never valid,
+ * 5 C2-DF, 6 E0, 7 E1-EC/EE-EF, 8 ED, 9 F0, 10 F1-F3, 11 F4. Overlong forms,
+ * surrogates and code points past U+10FFFF are all rejected by the table.
+ */
+enum {
+    UTF8_ACCEPT = 0,
+    UTF8_REJECT = 1,
+    UTF8_NEED1 = 2,     /* one more continuation byte */
+    UTF8_NEED2 = 3,
+    UTF8_AFTER_E0 = 4,  /* A0-BF, then one more */
+    UTF8_AFTER_ED = 5,  /* 80-9F, then one more */
+    UTF8_NEED3 = 6,
+    UTF8_AFTER_F0 = 7,  /* 90-BF, then two more */
+    UTF8_AFTER_F4 = 8,  /* 80-8F, then two more */
+    UTF8_STATES = 9
+};
+
+static const unsigned char utf8_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 7,
+    9, 10, 10, 10, 11, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+};
+
+/* Payload bits a lead byte of each class contributes. */
+static const unsigned char utf8_lead_mask[12] = {0x7f, 0, 0, 0, 0, 0x1f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07};
+
+#define A UTF8_ACCEPT
+#define R UTF8_REJECT
+static const unsigned char utf8_transition[UTF8_STATES][12] = {
+    /*                0  1  2  3  4  5           6              7           8              9              10          11 */
+    [UTF8_ACCEPT] = { A, R, R, R, R, UTF8_NEED1, UTF8_AFTER_E0, UTF8_NEED2, UTF8_AFTER_ED, UTF8_AFTER_F0, UTF8_NEED3, UTF8_AFTER_F4 },
+    [UTF8_REJECT] = { R, R, R, R, R, R, R, R, R, R, R, R },
+    [UTF8_NEED1] = { R, A, A, A, R, R, R, R, R, R, R, R },
+    [UTF8_NEED2] = { R, UTF8_NEED1, UTF8_NEED1, UTF8_NEED1, R, R, R, R, R, R, R, R },
+    [UTF8_AFTER_E0] = { R, R, R, UTF8_NEED1, R, R, R, R, R, R, R, R },
+    [UTF8_AFTER_ED] = { R, UTF8_NEED1, UTF8_NEED1, R, R, R, R, R, R, R, R, R },
+    [UTF8_NEED3] = { R, UTF8_NEED2, UTF8_NEED2, UTF8_NEED2, R, R, R, R, R, R, R, R },
+    [UTF8_AFTER_F0] = { R, R, UTF8_NEED2, UTF8_NEED2, R, R, R, R, R, R, R, R },
+    [UTF8_AFTER_F4] = { R, UTF8_NEED2, R, R, R, R, R, R, R, R, R, R },
+};
+#undef A
+#undef R
+
+typedef struct CodeRange {
+    uint32_t first;
+    uint32_t last;
+} CodeRange;
+
+/*
+ * Non-ASCII letters, digits and combining marks counted as word characters,
+ * sorted. Block-level approximations of the Unicode letter categories for the
+ * scripts we see in practice; punctuation and symbols inside those blocks are
+ * carved out where they are common (× ÷, Greek ; and ·, Indic dandas,
+ * the Katakana middle dot).
+ */
+static const CodeRange word_ranges[] = {
+    {0x00AA, 0x00AA}, {0x00B5, 0x00B5}, {0x00BA, 0x00BA},
+    {0x00C0, 0x00D6}, {0x00D8, 0x00F6}, {0x00F8, 0x02AF},   /* Latin-1, Latin Extended-A/B, IPA */
+    {0x0300, 0x036F},                                       /* combining diacritics */
+    {0x0370, 0x0373}, {0x0376, 0x0377}, {0x037B, 0x037D}, {0x037F, 0x037F},
+    {0x0386, 0x0386}, {0x0388, 0x03FF},                     /* Greek */
+    {0x0400, 0x0481}, {0x0483, 0x052F},                     /* Cyrillic */
+    {0x0531, 0x0556}, {0x0560, 0x0588},                     /* Armenian */
+    {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7},
+    {0x05D0, 0x05EA}, {0x05EF, 0x05F2},                     /* Hebrew */
+    {0x0610, 0x061A}, {0x0620, 0x0669}, {0x066E, 0x06D3}, {0x06D5, 0x06DC}, {0x06DF, 0x06E8},
+    {0x06EA, 0x06FC}, {0x06FF, 0x06FF},                     /* Arabic */
+    {0x0900, 0x0963}, {0x0966, 0x0DFF},                     /* Indic scripts */
+    {0x0E01, 0x0E3A}, {0x0E40, 0x0E4E}, {0x0E50, 0x0E59},   /* Thai */
+    {0x10A0, 0x10FA}, {0x10FC, 0x11FF},                     /* Georgian, Hangul Jamo */
+    {0x1E00, 0x1FBC}, {0x1FC2, 0x1FCC}, {0x1FD0, 0x1FDB}, {0x1FE0, 0x1FEC}, {0x1FF2, 0x1FFC},
+    {0x2D00, 0x2D25},                                       /* Georgian lowercase */
+    {0x3041, 0x3096}, {0x3099, 0x309F}, {0x30A1, 0x30FA}, {0x30FC, 0x30FF},   /* Kana */
+    {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},                     /* CJK ideographs */
+    {0xAC00, 0xD7A3},                                       /* Hangul syllables */
+    {0xFF10, 0xFF19}, {0xFF21, 0xFF3A}, {0xFF41, 0xFF5A},   /* fullwidth digits and Latin */
+    {0x20000, 0x3134F},                                     /* CJK extensions B-G */
+};
+
+/*
+ * Simple case folding for the bicameral scripts above, sorted by first. With
+ * stride 2 only every other code point (first, first + 2, ...) is an
+ * uppercase letter, as in Latin Extended-A where pairs alternate.
+ */
+typedef struct CaseFold {
+    uint32_t first;
+    uint32_t last;
+    int32_t delta;
+    uint32_t stride;
+} CaseFold;
+
+static const CaseFold case_folds[] = {
+    {0x00B5, 0x00B5, 775, 1}, {0x00C0, 0x00D6, 32, 1}, {0x00D8, 0x00DE, 32, 1},
+    {0x0100, 0x012E, 1, 2}, {0x0132, 0x0136, 1, 2}, {0x0139, 0x0147, 1, 2}, {0x014A, 0x0176, 1, 2},
+    {0x0178, 0x0178, -121, 1}, {0x0179, 0x017D, 1, 2}, {0x017F, 0x017F, -268, 1},
+    {0x01CD, 0x01DB, 1, 2}, {0x01DE, 0x01EE, 1, 2}, {0x0200, 0x021E, 1, 2}, {0x0222, 0x0232, 1, 2},
+    {0x0370, 0x0372, 1, 2}, {0x0376, 0x0376, 1, 1},
+    {0x0386, 0x0386, 38, 1}, {0x0388, 0x038A, 37, 1}, {0x038C, 0x038C, 64, 1}, {0x038E, 0x038F, 63, 1},
+    {0x0391, 0x03A1, 32, 1}, {0x03A3, 0x03AB, 32, 1}, {0x03C2, 0x03C2, 1, 1}, {0x03D8, 0x03EE, 1, 2},
+    {0x0400, 0x040F, 80, 1}, {0x0410, 0x042F, 32, 1}, {0x0460, 0x0480, 1, 2}, {0x048A, 0x04BE, 1, 2},
+    {0x04C0, 0x04C0, 15, 1}, {0x04C1, 0x04CD, 1, 2}, {0x04D0, 0x052E, 1, 2},
+    {0x0531, 0x0556, 48, 1},
+    {0x10A0, 0x10C5, 7264, 1},
+    {0x1E00, 0x1E94, 1, 2}, {0x1E9E, 0x1E9E, -7615, 1}, {0x1EA0, 0x1EFE, 1, 2},
+    {0x1F08, 0x1F0F, -8, 1}, {0x1F18, 0x1F1D, -8, 1}, {0x1F28, 0x1F2F, -8, 1}, {0x1F38, 0x1F3F, -8, 1},
+    {0x1F48, 0x1F4D, -8, 1}, {0x1F59, 0x1F5F, -8, 2}, {0x1F68, 0x1F6F, -8, 1},
+    {0xFF21, 0xFF3A, 32, 1},
+};
+
+static int is_word_codepoint(uint32_t codepoint) {
+    size_t low = 0;
+    size_t high = sizeof(word_ranges) / sizeof(word_ranges[0]);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (codepoint < word_ranges[mid].first) {
+            high = mid;
+        } else if (codepoint > word_ranges[mid].last) {
+            low = mid + 1;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t fold_codepoint(uint32_t codepoint) {
+    size_t low = 0;
+    size_t high = sizeof(case_folds) / sizeof(case_folds[0]);
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        const CaseFold *fold = &case_folds[mid];
+        if (codepoint < fold->first) {
+            high = mid;
+        } else if (codepoint > fold->last) {
+            low = mid + 1;
+        } else {
+            return (codepoint - fold->first) % fold->stride == 0 ? (uint32_t)((int32_t)codepoint + fold->delta)
+                                                                 : codepoint;
+        }
+    }
+    return codepoint;
+}
+
+/* Encode a code point as UTF-8 into out (at least 4 bytes); returns the length. */
+static size_t encode_utf8(uint32_t codepoint, char *out) {
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/*
+ * UTF-8 tokenizer. Apostrophes (and U+2019) keep a word going but are not
+ * stored. An invalid byte ends the current sequence and acts as a separator;
+ * if it interrupted a sequence it is pushed back, since it may start the next
+ * character.
+ */
+static int next_word_utf8(FILE *file, char *word, size_t size, int keep_apostrophes, int *truncated,
+                          size_t *consumed) {
+    size_t bytes = 0;
+    for (;;) {
+        size_t index = 0;
+        int in_word = 0;
+        unsigned state = UTF8_ACCEPT;
+        uint32_t codepoint = 0;
+        int ch;
+
+        while ((ch = getc_unlocked(file)) != EOF) {
+            ++bytes;
+            if (state == UTF8_ACCEPT && ch < 0x80) {
+                /* ASCII fast path: one table lookup, no decoding. */
+                unsigned char folded = ascii_fold[ch];
+                if (folded) {
+                    if (index + 1 >= size) {
+                        *truncated = 1;
+                        break;
+                    }
+                    word[index++] = (char)folded;
+                    in_word = 1;
+                } else if (keep_apostrophes && ch == '\'') {
+                    in_word = 1;
+                } else if (in_word) {
+                    break;
+                }
+                continue;
+            }
+
+            unsigned byte_class = utf8_class[ch];
+            unsigned previous = state;
+            codepoint = previous == UTF8_ACCEPT ? (uint32_t)(ch & utf8_lead_mask[byte_class])
+                                                : (codepoint << 6) | (uint32_t)(ch & 0x3F);
+            state = utf8_transition[previous][byte_class];
+            if (state == UTF8_REJECT) {
+                state = UTF8_ACCEPT;
+                if (previous != UTF8_ACCEPT) {
+                    ungetc(ch, file);
+                    --bytes;
+                }
+                if (in_word) {
+                    break;
+                }
+                continue;
+            }
+            if (state != UTF8_ACCEPT) {
+                continue;
+            }
+
+            if (keep_apostrophes && codepoint == 0x2019) {
+                in_word = 1;
+            } else if (is_word_codepoint(codepoint)) {
+                char encoded[4];
+                size_t length = encode_utf8(fold_codepoint(codepoint), encoded);
+                if (index + length >= size) {
+                    *truncated = 1;
+                    break;
+                }
+                for (size_t i = 0; i < length; ++i) {
+                    word[index++] = encoded[i];
+                }
+                in_word = 1;
+            } else if (in_word) {
+                break;
+            }
+        }
+
+        if ((index > 0 || ch == EOF) && consumed) {
+            *consumed = bytes;
+        }
+        if (index > 0) {
+            word[index] = '\0';
+            return 1;
+        }
+        /* A token of bare apostrophes has no letters: skip it rather than stopping. */
+        if (ch == EOF) {
+            return 0;
+        }
+    }
+}
+
+/* Tokenize the next alphanumeric word from the file. */
+int we_next_word(FILE *file, char *word, size_t size, int flags, int *truncated, size_t *consumed) {
+    int keep_apostrophes = (flags & WE_KEEP_APOSTROPHES) != 0;
+    if (flags & WE_UTF8) {
+        return next_word_utf8(file, word, size, keep_apostrophes, truncated, consumed);
+    }
+    size_t bytes = 0;
+    for (;;) {
+        int ch;
+        size_t index = 0;
+        int in_word = 0;
+
+        while ((ch = getc_unlocked(file)) != EOF) {
+            ++bytes;
+            unsigned char folded = ch < 0x80 ? ascii_fold[ch] : 0;
+            if (folded) {
+                if (index + 1 < size) {
+                    word[index++] = (char)folded;
+                    in_word = 1;
+                } else {
+                    /* Extension: record that we hit the max token length. */
+                    *truncated = 1;
+                    break;
+                }
+            } else if (keep_apostrophes && ch == '\'') {
+                /* Apostrophes join the word but are dropped from it. */
+                in_word = 1;
+            } else if (in_word) {
+                break;
+            }
+        }
+
+        if ((index > 0 || ch == EOF) && consumed) {
+            *consumed = bytes;
+        }
+        if (index > 0) {
+            word[index] = '\0';
+            return 1;
+        }
+        /* A token of bare apostrophes has no letters left: skip it rather than stopping. */
+        if (ch == EOF) {
+            return 0;
+        }
+    }
+}
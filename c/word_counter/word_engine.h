@@ -0,0 +1,36 @@
+/**
+ * @file word_engine.h
+ * @author Max Petite
+ * @date 2025-11-11
+ *
+ * Declares the tokenizer shared by the C word counter and the R native
+ * backend, so both count exactly the same words.
+ */
+
+#ifndef WORD_ENGINE_H
+#define WORD_ENGINE_H
+
+#include <stdio.h>
+
+/* Apostrophes join a word and are then dropped ("don't" -> "dont"); without this flag they separate words. */
+#define WE_KEEP_APOSTROPHES 1
+/*
+ * Decode the input as UTF-8: letters and digits of other scripts are word
+ * characters and are case-folded (simple folding, "ÉCOLE" -> "école"); U+2019
+ * counts as an apostrophe. Malformed bytes separate words. ASCII is classified
+ * from a fixed table, so the result does not depend on the C locale.
+ */
+#define WE_UTF8 2
+
+/*
+ * Reads the next word from file into word (lowercased, NUL-terminated,
+ * alphanumeric only; UTF-8 encoded under WE_UTF8). Returns 1 for a word and 0 at end of input. A token
+ * longer than size - 1 is cut there and *truncated is set; its remainder
+ * starts the next word. A UTF-8 character is never split by the cut. If
+ * consumed is not NULL it receives the bytes this call took from file,
+ * including skipped separators and the delimiter after the word, so a caller
+ * can track word-boundary offsets without ftello.
+ */
+int we_next_word(FILE *file, char *word, size_t size, int flags, int *truncated, size_t *consumed);
+
+#endif /* WORD_ENGINE_H */